@@ -0,0 +1,340 @@
+/*
+* Replacement of the global operator new and delete, and with glibc of
+* malloc and free, counting the allocations. Only built in with
+* COV_COUNT_ALLOCS: every allocation then updates shared counters.
+*/
+#include <stdlib.h>
+#include <new>
+
+#include "AllocCounter.h"
+
+#ifdef COV_COUNT_ALLOCS
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#define ATOMIC_ADD(var, n) InterlockedExchangeAdd64(&(var), (n))
+#define ATOMIC_CAS(var, old, n) InterlockedCompareExchange64(&(var), (n), (old))
+#define ALLOC_TLS __declspec(thread)
+#else
+#define ATOMIC_ADD(var, n) __sync_fetch_and_add(&(var), (n))
+#define ATOMIC_CAS(var, old, n) __sync_val_compare_and_swap(&(var), (old), (n))
+#define ALLOC_TLS __thread
+#endif
+
+#if defined(__GLIBC__) && !defined(COV_NO_MALLOC_HOOK)
+#define ALLOC_MALLOC_HOOK
+#include <malloc.h>
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *p, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *p);
+}
+#elif defined(_WIN32) && defined(_DEBUG) && !defined(COV_NO_MALLOC_HOOK)
+/* the debug C runtime (/MDd) is shared with the debug OpenCV DLLs, so its
+allocation hook sees the cv::Mat data as well */
+#define ALLOC_CRT_HOOK
+#include <crtdbg.h>
+#endif
+
+static volatile long long g_allocs = 0;
+static volatile long long g_bytes  = 0;
+static volatile long long g_live   = 0;
+static volatile long long g_peak   = 0;
+/* counts of the calling thread, plain TLS that never allocates */
+static ALLOC_TLS long long t_allocs = 0;
+static ALLOC_TLS long long t_bytes  = 0;
+
+/* ------------------------------------------------------------ */
+
+/* count an allocation of size bytes holding usable bytes of the heap */
+static void CountAlloc(size_t size, long long usable)
+{
+    ATOMIC_ADD(g_allocs, 1);
+    ATOMIC_ADD(g_bytes, (long long)size);
+    ++t_allocs;
+    t_bytes += (long long)size;
+    long long live = ATOMIC_ADD(g_live, usable) + usable;
+    long long peak = g_peak;
+    while (live > peak)
+    {
+        long long seen = ATOMIC_CAS(g_peak, peak, live);
+        if (seen == peak)
+        {
+            break;
+        }
+        peak = seen;
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+bool alloc::enabled()
+{
+    return true;
+}
+
+alloc::Counts alloc::counts()
+{
+    Counts c;
+    c.allocs = ATOMIC_ADD(g_allocs, 0);
+    c.bytes  = ATOMIC_ADD(g_bytes, 0);
+    c.live   = ATOMIC_ADD(g_live, 0);
+    c.peak   = ATOMIC_ADD(g_peak, 0);
+    return c;
+}
+
+alloc::Counts alloc::threadCounts()
+{
+    Counts c = counts();
+    c.allocs = t_allocs;
+    c.bytes  = t_bytes;
+    return c;
+}
+
+bool alloc::matDataCounted()
+{
+#if defined(ALLOC_MALLOC_HOOK) || defined(ALLOC_CRT_HOOK)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* ------------------------------------------------------------ */
+
+#ifdef ALLOC_MALLOC_HOOK
+/* the C allocator is counted, operator new goes through it */
+
+extern "C" void *malloc(size_t size) __THROW
+{
+    void *p = __libc_malloc(size);
+    if (p)
+    {
+        CountAlloc(size, (long long)malloc_usable_size(p));
+    }
+    return p;
+}
+
+extern "C" void *calloc(size_t n, size_t size) __THROW
+{
+    void *p = __libc_calloc(n, size);
+    if (p)
+    {
+        CountAlloc(n * size, (long long)malloc_usable_size(p));
+    }
+    return p;
+}
+
+extern "C" void *realloc(void *p, size_t size) __THROW
+{
+    long long old = p ? (long long)malloc_usable_size(p) : 0;
+    void *q = __libc_realloc(p, size);
+    if (q)
+    {
+        ATOMIC_ADD(g_live, -old);
+        CountAlloc(size, (long long)malloc_usable_size(q));
+    }
+    else if (!size)
+    {
+        ATOMIC_ADD(g_live, -old);
+    }
+    return q;
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) __THROW
+{
+    void *p = __libc_memalign(alignment, size);
+    if (p)
+    {
+        CountAlloc(size, (long long)malloc_usable_size(p));
+    }
+    return p;
+}
+
+extern "C" int posix_memalign(void **out, size_t alignment, size_t size) __THROW
+{
+    void *p = memalign(alignment, size);
+    if (!p)
+    {
+        return 12; // ENOMEM
+    }
+    *out = p;
+    return 0;
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return memalign(alignment, size);
+}
+
+extern "C" void free(void *p) __THROW
+{
+    if (p)
+    {
+        ATOMIC_ADD(g_live, -(long long)malloc_usable_size(p));
+        __libc_free(p);
+    }
+}
+
+static void *CountedAlloc(size_t size)
+{
+    return malloc(size ? size : 1);
+}
+
+static void CountedFree(void *p)
+{
+    free(p);
+}
+
+#elif defined(ALLOC_CRT_HOOK)
+/* the allocations of the C runtime are counted by its hook, operator new
+goes through malloc */
+
+static int __cdecl CrtAllocHook(int type, void *p, size_t size, int blockType,
+    long request, const unsigned char *file, int line)
+{
+    //the blocks of the runtime itself must be left alone
+    if (blockType == _CRT_BLOCK)
+    {
+        return TRUE;
+    }
+    if ((type == _HOOK_FREE || type == _HOOK_REALLOC) && p)
+    {
+        ATOMIC_ADD(g_live, -(long long)_msize_dbg(p, blockType));
+    }
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC)
+    {
+        CountAlloc(size, (long long)size);
+    }
+    return TRUE;
+}
+
+/* installed before main, the allocations of the static initialisers that
+run earlier are not counted */
+static int g_crtHook = (_CrtSetAllocHook(CrtAllocHook), 0);
+
+static void *CountedAlloc(size_t size)
+{
+    return malloc(size ? size : 1);
+}
+
+static void CountedFree(void *p)
+{
+    free(p);
+}
+
+#else
+/* only operator new is counted. The blocks are plain malloc blocks, which
+may be freed by another module, and their size is asked from the C runtime */
+
+#ifdef _WIN32
+#include <malloc.h>
+#define ALLOC_SIZE(p) (long long)_msize(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define ALLOC_SIZE(p) (long long)malloc_size(p)
+#else
+/* no size query, live and peak are not tracked */
+#define ALLOC_SIZE(p) 0LL
+#endif
+
+static void *CountedAlloc(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (p)
+    {
+        CountAlloc(size, ALLOC_SIZE(p));
+    }
+    return p;
+}
+
+static void CountedFree(void *p)
+{
+    if (p)
+    {
+        ATOMIC_ADD(g_live, -ALLOC_SIZE(p));
+        free(p);
+    }
+}
+#endif
+
+/* ------------------------------------------------------------ */
+
+void *operator new(size_t size)
+{
+    void *p = CountedAlloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    void *p = CountedAlloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t&) throw()
+{
+    return CountedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    return CountedAlloc(size);
+}
+
+void operator delete(void *p) throw()
+{
+    CountedFree(p);
+}
+
+void operator delete[](void *p) throw()
+{
+    CountedFree(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) throw()
+{
+    CountedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) throw()
+{
+    CountedFree(p);
+}
+
+#else
+/* counting is off, nothing is replaced */
+
+bool alloc::enabled()
+{
+    return false;
+}
+
+alloc::Counts alloc::counts()
+{
+    Counts c = {0, 0, 0, 0};
+    return c;
+}
+
+alloc::Counts alloc::threadCounts()
+{
+    return counts();
+}
+
+bool alloc::matDataCounted()
+{
+    return false;
+}
+#endif
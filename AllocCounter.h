@@ -0,0 +1,43 @@
+#ifndef __COV_ALLOC_COUNTER_H__
+#define __COV_ALLOC_COUNTER_H__
+/*
+* Counts of the heap allocations of the program, an instrumentation build:
+* nothing is replaced unless COV_COUNT_ALLOCS is defined, and the counts
+* then stay at zero (see enabled()). With it, the global operator new is
+* replaced in AllocCounter.cpp. With glibc, malloc, calloc, realloc, free
+* and the aligned allocations are replaced as well, forwarding to the glibc
+* implementation, so that the cv::Mat data allocated by cv::fastMalloc is
+* counted too. In the Debug configurations of the Windows project the
+* debug C runtime, which the debug OpenCV DLLs share, reports every block to
+* an allocation hook, with the same effect. Elsewhere fastMalloc calls the
+* malloc of the OpenCV library, which cannot be hooked, and only operator
+* new is counted; matDataCounted() tells which case applies. Defining
+* COV_NO_MALLOC_HOOK keeps malloc as is.
+*
+* The Windows project defines COV_COUNT_ALLOCS with
+* msbuild /p:CountAllocs=true, CMakeLists.txt with -DCOV_COUNT_ALLOCS=ON.
+*/
+
+namespace alloc
+{
+    /* allocations made since the start of the program */
+    struct Counts
+    {
+        long long allocs;
+        long long bytes;
+        /* bytes currently allocated and their maximum, over all threads */
+        long long live;
+        long long peak;
+    };
+
+    /* true when the program was built with COV_COUNT_ALLOCS */
+    bool enabled();
+    /* current totals, summed over all threads */
+    Counts counts();
+    /* allocations and bytes of the calling thread, live and peak of all */
+    Counts threadCounts();
+    /* true when the cv::Mat data is part of the counts */
+    bool matDataCounted();
+}
+
+#endif
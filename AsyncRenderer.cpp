@@ -0,0 +1,217 @@
+/*
+* Background rendering of the tracking results.
+*/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "AsyncRenderer.h"
+#include "debug.h"
+#include "utils.h"
+#include "Profiler.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#include <direct.h>
+#else
+#include <pthread.h>
+#include <sys/stat.h>
+#endif
+
+/***********************************************************/
+/* thin wrapper of the platform threads, std::thread is not available */
+#ifdef _WIN32
+struct RenderSync
+{
+    CRITICAL_SECTION   lock;
+    CONDITION_VARIABLE ready;
+    HANDLE             thread;
+
+    RenderSync()  { InitializeCriticalSection(&lock); InitializeConditionVariable(&ready); }
+    ~RenderSync() { DeleteCriticalSection(&lock); }
+    void acquire() { EnterCriticalSection(&lock); }
+    void release() { LeaveCriticalSection(&lock); }
+    void wait()    { SleepConditionVariableCS(&ready, &lock, INFINITE); }
+    void signal()  { WakeConditionVariable(&ready); }
+
+    static unsigned __stdcall entry(void *arg)
+    {
+        ((AsyncRenderer*)arg)->run();
+        return 0;
+    }
+    void start(AsyncRenderer *r) { thread = (HANDLE)_beginthreadex(NULL, 0, entry, r, 0, NULL); }
+    void join()  { WaitForSingleObject(thread, INFINITE); CloseHandle(thread); }
+};
+#else
+struct RenderSync
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;
+    pthread_t       thread;
+
+    RenderSync()  { pthread_mutex_init(&lock, NULL); pthread_cond_init(&ready, NULL); }
+    ~RenderSync() { pthread_cond_destroy(&ready); pthread_mutex_destroy(&lock); }
+    void acquire() { pthread_mutex_lock(&lock); }
+    void release() { pthread_mutex_unlock(&lock); }
+    void wait()    { pthread_cond_wait(&ready, &lock); }
+    void signal()  { pthread_cond_signal(&ready); }
+
+    static void *entry(void *arg)
+    {
+        ((AsyncRenderer*)arg)->run();
+        return NULL;
+    }
+    void start(AsyncRenderer *r) { pthread_create(&thread, NULL, entry, r); }
+    void join()  { pthread_join(thread, NULL); }
+};
+#endif
+
+/***********************************************************/
+/* create the directory dir unless it exists, its parent must exist */
+static bool MakeDir(string dir)
+{
+    while (dir.size() > 1 && (dir[dir.size()-1] == '/' || dir[dir.size()-1] == '\\'))
+    {
+        dir.erase(dir.size()-1);
+    }
+#ifdef _WIN32
+    int rc = _mkdir(dir.c_str());
+#else
+    int rc = mkdir(dir.c_str(), 0755);
+#endif
+    return rc == 0 || errno == EEXIST;
+}
+/***********************************************************/
+AsyncRenderer::AsyncRenderer(Parameter &para)
+    : m_written(0), m_dropped(0),
+      m_capacity(max(para.renderQueue, 1)), m_stop(false),
+      m_mode(para.render), m_prefix(para.renderDir + para.file)
+{
+    //the default render_dir is not part of the repository
+    if (!MakeDir(para.renderDir))
+    {
+        ERROR_OUT__<<" cannot create the render directory "<<para.renderDir<<endl;
+    }
+    m_draw9 = para.v_draw9;
+    m_draw3 = para.v_draw3;
+    m_sync  = new RenderSync();
+    m_sync->start(this);
+}
+/***********************************************************/
+AsyncRenderer::~AsyncRenderer()
+{
+    m_sync->acquire();
+    m_stop = true;
+    m_sync->signal();
+    m_sync->release();
+    m_sync->join();
+    delete m_sync;
+    m_writer.release();
+    cerr<<"Rendered "<<m_written<<" frames of "<<m_prefix
+        <<", dropped "<<m_dropped<<endl;
+}
+/***********************************************************/
+RenderFrame AsyncRenderer::snapshot(CovImage &covimg, int frameNum)
+{
+    PROF_SCOPE(PROF_DISPLAY);
+    RenderFrame frame;
+    frame.frameNum = frameNum;
+    frame.image    = covimg.im_in.clone();
+    frame.rois     = covimg.mROIs;
+    return frame;
+}
+/***********************************************************/
+RenderTarget AsyncRenderer::snapshot(Cparticle &tarpar, Parameter &para, Mat pos_gt)
+{
+    RenderTarget target;
+    target.pos       = tarpar.m_pos.clone();
+    target.particles = tarpar.par_pos.rowRange(0, min(para.nParticles, tarpar.par_pos.rows)).clone();
+    target.nModes    = para.nModes;
+    target.mode      = para.currentMode;
+    target.pos_gt    = pos_gt.clone();
+    return target;
+}
+/***********************************************************/
+void AsyncRenderer::push(RenderFrame &frame)
+{
+    PROF_SCOPE(PROF_DISPLAY);
+    m_sync->acquire();
+    if (m_queue.size() >= m_capacity)
+    {
+        ++m_dropped;
+    }
+    else
+    {
+        m_queue.push_back(frame);
+        m_sync->signal();
+    }
+    m_sync->release();
+}
+/***********************************************************/
+void AsyncRenderer::run()
+{
+    for (;;)
+    {
+        m_sync->acquire();
+        while (m_queue.empty() && !m_stop)
+        {
+            m_sync->wait();
+        }
+        if (m_queue.empty())
+        {
+            m_sync->release();
+            break;
+        }
+        RenderFrame frame = m_queue.front();
+        m_queue.pop_front();
+        m_sync->release();
+
+        draw(frame);
+        write(frame);
+    }
+}
+/***********************************************************/
+void AsyncRenderer::draw(RenderFrame &frame)
+{
+    for (int k = 0; k < frame.targets.size(); ++k)
+    {
+        RenderTarget &t = frame.targets[k];
+        const vector<int> &outline = t.nModes == 9 ? m_draw9[t.mode] : m_draw3[t.mode];
+        utils::DrawTarget(frame.image, t.pos, t.particles, t.nModes, outline, t.pos_gt);
+    }
+    utils::DrawSearchAreas(frame.image, frame.rois);
+}
+/***********************************************************/
+void AsyncRenderer::write(RenderFrame &frame)
+{
+    if (m_mode == 2)
+    {
+        if (!m_writer.isOpened())
+        {
+            m_writer.open(m_prefix + ".avi", CV_FOURCC('M','J','P','G'), 25, frame.image.size());
+            if (!m_writer.isOpened())
+            {
+                ERROR_OUT__<<" cannot open "<<m_prefix<<".avi"<<endl;
+                return;
+            }
+        }
+        m_writer<<frame.image;
+    }
+    else
+    {
+        char name[16];
+        sprintf(name, "_%05d.jpg", frame.frameNum);
+        if (!imwrite(m_prefix + name, frame.image))
+        {
+            ERROR_OUT__<<" cannot write "<<m_prefix<<name<<endl;
+            return;
+        }
+    }
+    ++m_written;
+}
@@ -0,0 +1,94 @@
+#ifndef __COV_ASYNC_RENDERER_H__
+#define __COV_ASYNC_RENDERER_H__
+/*
+* Background rendering of the tracking results. The tracker hands over a
+* snapshot of the frame and of the state of its targets; a worker thread
+* draws the overlays and writes them to an image sequence or a video. The
+* queue is bounded and a snapshot is dropped rather than waited for, so the
+* rendering never blocks the tracking.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <vector>
+#include <deque>
+#include <string>
+
+#include "covImage.h"
+#include "Cparticle.h"
+#include "SParater.h"
+
+using namespace std;
+using namespace cv;
+
+/* state of one target needed to draw it */
+struct RenderTarget
+{
+    Mat pos;
+    Mat particles;
+    int nModes;
+    int mode;
+    Mat pos_gt;
+};
+
+/* a frame and everything drawn on it */
+struct RenderFrame
+{
+    int frameNum;
+    Mat image;
+    vector<vector<int>> rois;
+    vector<RenderTarget> targets;
+};
+
+/* platform mutex, condition variable and thread */
+struct RenderSync;
+
+class AsyncRenderer
+{
+public:
+    /* para.render selects images (1) or a video (2) in para.renderDir,
+    named after para.file
+    */
+    AsyncRenderer(Parameter &para);
+    /* renders the frames still queued, then stops the worker */
+    ~AsyncRenderer();
+
+    /* copy the frame and the search areas of covimg before anything is
+    drawn on it
+    */
+    static RenderFrame snapshot(CovImage &covimg, int frameNum);
+    /* copy the state of one target */
+    static RenderTarget snapshot(Cparticle &tarpar, Parameter &para, Mat pos_gt);
+    /* queue a frame, drop it when the queue is full */
+    void push(RenderFrame &frame);
+
+    int m_written;
+    int m_dropped;
+
+private:
+    AsyncRenderer(const AsyncRenderer&);
+    AsyncRenderer& operator=(const AsyncRenderer&);
+
+    /* body of the worker thread */
+    void run();
+    void draw(RenderFrame &frame);
+    void write(RenderFrame &frame);
+
+    friend struct RenderSync;
+    RenderSync *m_sync;
+    deque<RenderFrame> m_queue;
+    size_t m_capacity;
+    bool m_stop;
+
+    int m_mode;
+    string m_prefix;
+    VideoWriter m_writer;
+    vector<vector<int>> m_draw9;
+    vector<vector<int>> m_draw3;
+};
+
+#endif
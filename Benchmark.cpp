@@ -0,0 +1,214 @@
+/* Micro-benchmarks of the hot paths of CovImage and Cparticle on a synthetic
+frame. Run as "Test6 bench [rows=480] [cols=640] [channels=3] [box=64]
+[iters=0] [seed=1] [max_allocs=-1]": box is the size of the target, centred
+in the frame, whose search area is integrated; iters = 0 chooses the number
+of iterations of every stage from a time budget. With max_allocs >= 0 the
+particle loop (ParticleProcess) may make at most that many allocations per
+particle in steady state, otherwise the benchmark fails with exit code 1;
+max_allocs=0 requires an allocation-free particle loop. The check needs the
+cv::Mat data to be counted (alloc::matDataCounted()) and fails otherwise.
+
+One CSV line is printed per stage:
+  stage,rows,cols,channels,box,iters,ns_per_op,ops_per_sec,pixels_per_sec,
+  allocs_per_op,alloc_bytes_per_op
+pixels_per_sec is 0 for stages that do not scale with the number of pixels.
+Allocations count operator new, and with glibc malloc as well, which
+includes the cv::Mat data (see AllocCounter.h); they are NA unless the
+program is built with COV_COUNT_ALLOCS. An unknown argument exits with 1.
+*/
+
+#include "Test6.h"
+#include "AllocCounter.h"
+
+/* settings of the benchmark */
+struct BenchConfig
+{
+    int rows;
+    int cols;
+    int channels;
+    int box;
+    int iters;
+    int seed;
+    int maxAllocs;
+};
+
+/* ------------------------------------------------------------ */
+
+/* time iters calls of f, after one warm-up call. When iters is 0 the number
+of calls is grown until they take at least 0.2s. Returns the allocations
+per call.
+*/
+template <class F>
+static double Bench(const string &stage, const BenchConfig &cfg, double pixels, F f)
+{
+    f();
+    int iters = cfg.iters > 0 ? cfg.iters : 1;
+    double seconds;
+    alloc::Counts a0, a1;
+    for (;;)
+    {
+        a0 = alloc::counts();
+        int64 t = getTickCount();
+        for (int n = 0; n < iters; ++n)
+        {
+            f();
+        }
+        seconds = (getTickCount() - t) / getTickFrequency();
+        a1 = alloc::counts();
+        if (cfg.iters > 0 || seconds >= 0.2 || iters >= (1 << 24))
+        {
+            break;
+        }
+        iters *= seconds > 0.02 ? (int)(0.2 / seconds) + 1 : 10;
+    }
+    double ops = iters / max(seconds, 1e-12);
+    cout<<stage<<","<<cfg.rows<<","<<cfg.cols<<","<<cfg.channels<<","<<cfg.box<<","
+        <<iters<<","<<1e9 / ops<<","<<ops<<","<<pixels * ops<<",";
+    //without counting the allocation columns are not measurements
+    if (alloc::enabled())
+    {
+        cout<<double(a1.allocs - a0.allocs) / iters<<","
+            <<double(a1.bytes - a0.bytes) / iters<<endl;
+    }
+    else
+    {
+        cout<<"NA,NA"<<endl;
+    }
+    return double(a1.allocs - a0.allocs) / iters;
+}
+
+/* ------------------------------------------------------------ */
+
+int mainbench(int argc, char** argv)
+{
+    map<string,double> args;
+    args["rows"]  = 480; args["cols"]  = 640; args["channels"] = 3;
+    args["box"]   = 64;  args["iters"] = 0;   args["seed"]     = 1;
+    args["max_allocs"] = -1;
+    if (!utils::ParseArgs(argc, argv, args))
+    {
+        return 1;
+    }
+    BenchConfig cfg;
+    cfg.rows      = (int)args["rows"];
+    cfg.cols      = (int)args["cols"];
+    cfg.channels  = (int)args["channels"];
+    cfg.box       = (int)args["box"];
+    cfg.iters     = (int)args["iters"];
+    cfg.seed      = (int)args["seed"];
+    cfg.maxAllocs = (int)args["max_allocs"];
+
+    //synthetic frame: a gradient with uniform noise, so that the covariances
+    //are well conditioned
+    Mat frame(cfg.rows, cfg.cols, cfg.channels == 1 ? CV_8UC1 : CV_8UC3);
+    RNG rng(cfg.seed);
+    rng.fill(frame, RNG::UNIFORM, Scalar::all(0), Scalar::all(64));
+    for (int y = 0; y < cfg.rows; ++y)
+    {
+        uchar *p = frame.ptr<uchar>(y);
+        for (int x = 0; x < cfg.cols * cfg.channels; ++x)
+        {
+            p[x] = saturate_cast<uchar>(p[x] + (x / cfg.channels + 2 * y) % 192);
+        }
+    }
+    double x1 = (cfg.cols - cfg.box) / 2, y1 = (cfg.rows - cfg.box) / 2;
+    Mat tarpos = (Mat_<double>(1,4)<< x1, y1, x1 + cfg.box, y1 + cfg.box);
+
+    //parameters: common keys of config.ini, 9 modes
+    Parameter para;
+    para.file = "";
+    utils::InitPara(para);
+    para.nModes   = 9;
+    para.adaptive = 0;
+    para.memo     = 0;
+    cerr<<endl;
+
+    CovImage cim(frame, tarpos);
+    vector<int> &sa = cim.mSearchArea;
+    double workPixels   = (double)cim.mWork.area();
+    double searchPixels = (double)(sa[2] - sa[0]) * (sa[3] - sa[1]);
+    double boxPixels    = (double)cfg.box * cfg.box;
+
+    if (!alloc::enabled())
+    {
+        cerr<<"Allocations are not counted in this build (COV_COUNT_ALLOCS), they are NA"<<endl;
+    }
+    cout<<"stage,rows,cols,channels,box,iters,ns_per_op,ops_per_sec,pixels_per_sec,"
+        <<"allocs_per_op,alloc_bytes_per_op"<<endl;
+    //feature image
+    Bench("imin_rgb2lab", cfg, workPixels, [&]() {
+        cim.imin_rgb2lab();
+    });
+    Bench("process", cfg, searchPixels, [&]() {
+        cim.process();
+    });
+    Bench("computeIntegralImage", cfg, searchPixels, [&]() {
+        cim.computeIntegralImage();
+    });
+    //region descriptors
+    Mat prodM, sumM;
+    double Npixels;
+    Bench("covComponentMatrices", cfg, 0, [&]() {
+        cim.covComponentMatrices(x1 + 0.5, y1 + 0.5, x1 + cfg.box - 0.5, y1 + cfg.box - 0.5,
+            prodM, sumM, Npixels);
+    });
+    Bench("covMatrix", cfg, 0, [&]() {
+        cim.covMatrix(x1 + 0.5, y1 + 0.5, x1 + cfg.box - 0.5, y1 + cfg.box - 0.5, Npixels);
+    });
+    //target and particles
+    Cparticle tarpar(cim, para, tarpos);
+    Bench("calc9covmat", cfg, boxPixels, [&]() {
+        tarpar.calc9covmat(cim, para.v9);
+    });
+    Bench("logm", cfg, 0, [&]() {
+        tarpar.logm();
+    });
+    tarpar.calc9covmat(cim, para.v9);
+    tarpar.logm();
+    tarpar.m_candidates.reserve(para, cim.dim);
+    tarpar.m_candidates.setActiveModes(para.tran_matrix9.ptr<double>(0));
+    tarpar.par_dis  = Mat::zeros(para.nParticles, para.nModes, CV_64F);
+    tarpar.par_prob = Mat::zeros(para.nParticles, para.nModes, CV_64F);
+    tarpar.sum_prob = Mat::zeros(1, para.nModes, CV_64F);
+    vector<int> inside;
+    vector<int> searcharea = cim.calcSearchArea(tarpar.m_pos);
+    for (int j = 0; j < para.nParticles; ++j)
+    {
+        if (!utils::IsParticleOutFrame(tarpar.par_pos.row(j), searcharea))
+        {
+            inside.push_back(j);
+        }
+    }
+    if (inside.empty())
+    {
+        ERROR_OUT__<<" no particle inside the search area"<<endl;
+        return 1;
+    }
+    int next = 0;
+    double particleAllocs = Bench("ParticleProcess", cfg, boxPixels, [&]() {
+        tarpar.ParticleProcess(cim, para, inside[next]);
+        next = (next + 1) % inside.size();
+    });
+    //the weights stay normalised over repeated resamplings
+    Mat max_prob_index = Mat::zeros(1, para.nModes, CV_32S);
+    utils::ProcessAllParticles(tarpar, max_prob_index);
+    tarpar.NormProb();
+    tarpar.sum_prob = Mat::ones(1, para.nModes, CV_64F);
+    Bench("ResampleParticle", cfg, 0, [&]() {
+        tarpar.ResampleParticle(para);
+    });
+    if (cfg.maxAllocs >= 0 && !alloc::matDataCounted())
+    {
+        //the cv::Mat temporaries of the loop would go unseen
+        cerr<<"[FAIL] max_allocs needs a build with COV_COUNT_ALLOCS that counts the cv::Mat data "
+            <<"(glibc, or a Debug configuration on Windows)"<<endl;
+        return 1;
+    }
+    if (cfg.maxAllocs >= 0 && particleAllocs > cfg.maxAllocs)
+    {
+        cerr<<"[FAIL] ParticleProcess makes "<<particleAllocs<<" allocations per particle, "
+            <<"at most "<<cfg.maxAllocs<<" are allowed"<<endl;
+        return 1;
+    }
+    return 0;
+}
@@ -19,13 +19,7 @@
 #include "debug.h"
 #include "utils.h"
 #include <fstream>
-/***********************************************************/
-Mat Cparticle::par_pos;
-Mat Cparticle::par_dis;
-Mat Cparticle::par_prob;
-Mat Cparticle::sum_prob;
-Mat Cparticle::stddevm;
-
+#include <algorithm>
 /***********************************************************/
 void Cparticle::calccovmat(CovImage &cim, Parameter &para){
     if(para.nModes == 9)
@@ -50,17 +44,20 @@ void Cparticle::calc9covmat(CovImage &cim,vector<vector<int>> &v)
 
     double *ptr = m_pos.ptr<double>(0);
     utils::getQuadrants(*(ptr), *(ptr+1), *(ptr+2), *(ptr+3), qx1, qy1, qx2, qy2);
-    for (int i=0; i < 4; i++) 
     {
-        cim.covComponentMatrices(qx1[i], qy1[i], qx2[i], qy2[i],
-            IIprod[i], IIsum[i], Npixels[i]);
+        PROF_SCOPE(PROF_COVARIANCE);
+        for (int i=0; i < 4; i++) 
+        {
+            cim.covComponentMatrices(qx1[i], qy1[i], qx2[i], qy2[i],
+                IIprod[i], IIsum[i], Npixels[i]);
+        }
     }
 
     for(int i = 0; i < v.size() ; i++)
     {
         Mat iiprod = Mat::zeros(IIprod[0].rows,IIprod[0].cols,CV_64F); 
         Mat iisum  =  Mat::zeros(IIsum[0].rows,IIsum[0].cols,CV_64F);
-        int N      = 0;
+        double N   = 0;
         for(int j = 0; j < v[i].size(); j++)
         {
             iiprod += IIprod[v[i][j]];
@@ -83,16 +80,19 @@ void Cparticle::calc3covmat(CovImage &cim, vector<vector<int>> &v)
 
     double *ptr = m_pos.ptr<double>(0);
     utils::getVerticalHalf(*(ptr), *(ptr+1), *(ptr+2), *(ptr+3), qx1, qy1, qx2, qy2);
-    for (int i = 0; i < 2; i++) 
     {
-        cim.covComponentMatrices(qx1[i], qy1[i], qx2[i], qy2[i],
-            IIprod[i], IIsum[i], Npixels[i]);
+        PROF_SCOPE(PROF_COVARIANCE);
+        for (int i = 0; i < 2; i++) 
+        {
+            cim.covComponentMatrices(qx1[i], qy1[i], qx2[i], qy2[i],
+                IIprod[i], IIsum[i], Npixels[i]);
+        }
     }
     for(int i = 0; i < v.size() ; i++)
     {
         Mat iiprod = Mat::zeros(IIprod[0].rows,IIprod[0].cols,CV_64F); 
         Mat iisum  =  Mat::zeros(IIsum[0].rows,IIsum[0].cols,CV_64F);
-        int N      = 0;
+        double N   = 0;
         for(int j = 0; j < v[i].size(); j++)
         {
             iiprod += IIprod[v[i][j]];
@@ -103,6 +103,13 @@ void Cparticle::calc3covmat(CovImage &cim, vector<vector<int>> &v)
     }
 }
 /***********************************************************/
+void Cparticle::calcmeandesc(CovImage &cim, Parameter &para)
+{
+    m_meanDesc.create(1, ParticleBuffer::meanLength(para.nModes, cim.dim), CV_64F);
+    ParticleBuffer::calcmean(cim, para.nModes, m_pos.ptr<double>(0),
+        m_meanDesc.ptr<double>(0));
+}
+/***********************************************************/
 void Cparticle::logm()
 {
     for(int i = 0; i < m_cmat.size();i++)
@@ -116,31 +123,60 @@ void Cparticle::logm()
         m_logmCmat[i] = U*V; 
         m_logmCmat[i] = (m_logmCmat[i] + m_logmCmat[i].t())/2;
     }
+    // pack the template once for the distances of all particles
+    m_logmPacked.resize(m_logmCmat.size());
+    for(int i = 0; i < m_logmCmat.size();i++)
+    {
+        int n = m_logmCmat[i].rows;
+        m_logmPacked[i].create(1, n*(n+1)/2, CV_64F);
+        ParticleBuffer::packlogm(m_logmCmat[i], m_logmPacked[i].ptr<double>(0));
+    }
 }
 /***********************************************************/
-void Cparticle::ParticleProcess(Cparticle &tarpar,int k){
-    double *pdis  = Cparticle::par_dis.ptr<double>(k);
-    double *pprob = Cparticle::par_prob.ptr<double>(k);
-    double *psum  = Cparticle::sum_prob.ptr<double>(0);
+void Cparticle::ParticleProcess(CovImage &cim, Parameter &para, int k){
+    if (!m_candidates.reuseBox(par_pos.ptr<double>(k), k))
+    {
+        m_candidates.calccovmat(cim, para, par_pos.ptr<double>(k), k);
+        m_candidates.logm(k);
+    }
+    PROF_SCOPE(PROF_DISTANCE);
+    double *pdis  = par_dis.ptr<double>(k);
+    double *pprob = par_prob.ptr<double>(k);
+    double *psum  = sum_prob.ptr<double>(0);
     for(int i = 0; i < m_logmCmat.size() ; ++i, ++pdis, ++pprob, ++psum)
     {
-//         cout<<tarpar.m_logmCmat[i]<<endl;
-//         cout<<m_logmCmat[i]<<endl;
-        *pdis   = norm(m_logmCmat[i] - tarpar.m_logmCmat[i]);
+        if (!m_candidates.active[i])
+        {
+            continue;
+        }
+        *pdis   = CandidateDistance(m_candidates, k, i);
         *pprob  = 1/(*pdis);
         *psum  += *pprob;
     }
 }
 /***********************************************************/
+double Cparticle::CandidateDistance(ParticleBuffer &buf, int k, int i)
+{
+    if (m_tmplib.size() > 1)
+    {
+        return buf.nearestDistance(k, i, m_tmplPacked[i], m_tmplNorm2[i]);
+    }
+    return buf.distance(k, i, m_logmPacked[i].ptr<double>(0));
+}
+/***********************************************************/
 void Cparticle::NormProb()
 {
-    for (int i = 0; i < Cparticle::par_prob.rows; ++i)
+    for (int i = 0; i < par_prob.rows; ++i)
     {
-        double *pprob = Cparticle::par_prob.ptr<double>(i);
-        double *psum  = Cparticle::sum_prob.ptr<double>(0);
-        for (int j = 0; j < Cparticle::par_prob.cols; ++j, ++pprob, ++psum)
+        double *pprob = par_prob.ptr<double>(i);
+        double *psum  = sum_prob.ptr<double>(0);
+        for (int j = 0; j < par_prob.cols; ++j, ++pprob, ++psum)
         {
-            *pprob /= *psum;
+            // modes that were not evaluated have no probability at all
+            if (*psum > 0)
+            {
+                *pprob /= *psum;
+            }
         }
     }
 }
@@ -150,26 +186,53 @@ void Cparticle::updateStddev(const Parameter &para)
     double *ptarpos = m_pos.ptr<double>(0);
     double width    = *(ptarpos+2) - *ptarpos;
     double height   = *(ptarpos+3) - *(ptarpos+1);
-    Cparticle::stddevm = (Mat_<double>(1,4)<<para.std_x, para.std_y, 
+    stddevm = (Mat_<double>(1,4)<<para.std_x, para.std_y, 
         para.std_gain_w*width/3 , para.std_gain_h*height/3);
 }
 /***********************************************************/
+void Cparticle::packTemplates()
+{
+    int nModes = (int)m_logmCmat.size();
+    int K      = (int)m_tmplib.size();
+    m_tmplPacked.resize(nModes);
+    m_tmplNorm2.resize(nModes);
+    for(int i = 0; i < nModes; ++i)
+    {
+        int n = m_logmCmat[i].rows;
+        m_tmplPacked[i].create(K, n*(n+1)/2, CV_64F);
+        m_tmplNorm2[i].create(K, 1, CV_64F);
+        for(int t = 0; t < K; ++t)
+        {
+            ParticleBuffer::packlogm(m_tmplib[t][i], m_tmplPacked[i].ptr<double>(t));
+            Mat row = m_tmplPacked[i].row(t);
+            m_tmplNorm2[i].at<double>(t) = row.dot(row);
+        }
+    }
+}
+/***********************************************************/
 void Cparticle::updateModel(CovImage &covimg,Parameter &para, int frameNo){
+    PROF_SCOPE(PROF_UPDATE);
     if(para.updateFreq != 0 && para.currentMode == 0 && frameNo % para.updateFreq == 0){
         calccovmat(covimg,para);
         logm();
-        m_tmplib.pop_front();
+        calcmeandesc(covimg,para);
+        //the library grows up to para.templateNo templates, then the
+        //oldest one is dropped
         m_tmplib.push_back(m_logmCmat);
         for(int i = 0 ; i < para.nModes ; ++i){
-            m_tmplib[para.templateNo-1][i] = m_logmCmat[i].clone();
+            m_tmplib.back()[i] = m_logmCmat[i].clone();
+        }
+        if((int)m_tmplib.size() > para.templateNo){
+            m_tmplib.pop_front();
         }
+        packTemplates();
         cerr<<"Model updated!"<<endl;
     } 
 }
 /***********************************************************/
 void Cparticle::GenParticlePostion(const Parameter &para)
 {
-    double* pstddev = Cparticle::stddevm.ptr<double>(0);
+    double* pstddev = stddevm.ptr<double>(0);
     double* ptarpos = m_pos.ptr<double>(0);
     Mat tarpos_wh   = Mat::zeros(1,4,CV_64F);
     double* ptarpos_wh  = tarpos_wh.ptr<double>(0);
@@ -179,70 +242,122 @@ void Cparticle::GenParticlePostion(const Parameter &para)
     *(ptarpos_wh + 3)   = *(ptarpos + 3) - *(ptarpos + 1);
     
     Mat ParPos_wh       = Mat(para.nParticles,4,CV_64F); 
-    Cparticle::par_pos  = Mat(para.nParticles,4,CV_64F); 
+    par_pos  = Mat(para.nParticles,4,CV_64F); 
 
     for(int i = 0; i < 4; ++i, ++ptarpos_wh, ++pstddev)
     {
-        theRNG().state = getTickCount();
-        randn(ParPos_wh.col(i),(double)(*ptarpos_wh),(double)(*pstddev));
+        Mat col = ParPos_wh.col(i);
+        m_rng.fill(col,RNG::NORMAL,Scalar(*ptarpos_wh),Scalar(*pstddev));
     }
-    Cparticle::par_pos.col(0) = ParPos_wh.col(0) * 1.0;
-    Cparticle::par_pos.col(1) = ParPos_wh.col(1) * 1.0;
-    Cparticle::par_pos.col(2) = ParPos_wh.col(2) + ParPos_wh.col(0);
-    Cparticle::par_pos.col(3) = ParPos_wh.col(3) + ParPos_wh.col(1);
+    par_pos.col(0) = ParPos_wh.col(0) * 1.0;
+    par_pos.col(1) = ParPos_wh.col(1) * 1.0;
+    par_pos.col(2) = ParPos_wh.col(2) + ParPos_wh.col(0);
+    par_pos.col(3) = ParPos_wh.col(3) + ParPos_wh.col(1);
 }
 /***********************************************************/
 void Cparticle::ResampleParticle(Parameter &para)
 {
+    PROF_SCOPE(PROF_RESAMPLE);
     //update standard deviation
     updateStddev(para);
-    //sort probability
+    //normalise probability
     NormProb();
-//     cout<<Cparticle::par_dis<<endl;
-//     cout<<Cparticle::par_prob<<endl;
-//     cout<<Cparticle::sum_prob<<endl;
+//     cout<<par_dis<<endl;
+//     cout<<par_prob<<endl;
+//     cout<<sum_prob<<endl;
 
-    Mat current_prob = Cparticle::par_prob.col(para.currentMode).clone();
-    Mat current_prob_idx;
-    cv::sortIdx(current_prob,
-        current_prob_idx,
-        CV_SORT_DESCENDING + CV_SORT_EVERY_COLUMN);
-    //resampling
-    Vector<int> CountPar(Cparticle::par_prob.rows);
-    
-    for (int i = 0; i < CountPar.size(); ++i)
+    int nIn  = par_pos.rows;
+    int nOut = para.nParticles;
+    //cumulative weight of the particles in the current mode
+    m_cumw.resize(nIn);
+    double total = 0;
+    for (int j = 0; j < nIn; ++j)
     {
-        CountPar[i] = ceil(current_prob.at<double>(i) * para.nParticles); 
+        total += par_prob.at<double>(j,para.currentMode);
+        m_cumw[j] = total;
     }
-    Mat ParPos_wh       = Mat::zeros(para.nParticles,4,CV_64F); 
-    for(int i = 0, k = 0; i < para.nParticles ; ++k)
+    if (total <= 0)
     {
-        int par_no = current_prob_idx.at<__int32>(k);
-        int count = CountPar[par_no];
-        for(int j = 0 ; j < count && i < para.nParticles; ++j, ++i)
+        //no particle was evaluated, keep them all with the same weight
+        for (int j = 0; j < nIn; ++j)
         {
-            double *pParPosTmp = ParPos_wh.ptr<double>(i);
-            double *pParPos    = Cparticle::par_pos.ptr<double>(par_no);
-            *pParPosTmp = *pParPos;
-            *(pParPosTmp+1) = *(pParPos+1);
-            *(pParPosTmp+2) = *(pParPos+2) - *pParPos;
-            *(pParPosTmp+3) = *(pParPos+3) - *(pParPos+1);
+            m_cumw[j] = j + 1;
         }
+        total = nIn;
     }
-    double* pstddev = Cparticle::stddevm.ptr<double>(0);
-    for(int i = 0; i < 4; ++i, ++pstddev)
+    //choose the number of particles from the spread of the weighted set
+    if (para.adaptive)
     {
-        Mat noise = Mat::zeros(ParPos_wh.rows,1,CV_64F);
-        theRNG().state = getTickCount();
-        randn(noise,0,(double)(*pstddev));
-        ParPos_wh.col(i) += noise;
+        nOut = KLDParticleNum(para,total);
+        para.nParticles = nOut;
     }
-
-    Cparticle::par_pos = Mat::zeros(ParPos_wh.rows,ParPos_wh.cols,CV_64F);
-    Cparticle::par_pos.col(0) = ParPos_wh.col(0) * 1.0;
-    Cparticle::par_pos.col(1) = ParPos_wh.col(1) * 1.0;
-    Cparticle::par_pos.col(2) = ParPos_wh.col(2) + ParPos_wh.col(0);
-    Cparticle::par_pos.col(3) = ParPos_wh.col(3) + ParPos_wh.col(1);  
+    //draw the noise of the four box parameters [x,y,w,h] of all particles
+    //at once
+    double* pstddev = stddevm.ptr<double>(0);
+    m_noise.create(nOut,4,CV_64F);
+    Mat noise4 = m_noise.reshape(4);
+    m_rng.fill(noise4,RNG::NORMAL,Scalar::all(0),
+        Scalar(*pstddev,*(pstddev+1),*(pstddev+2),*(pstddev+3)));
+    //systematic resampling: nOut evenly spaced pointers with one random
+    //offset walk once through the cumulative weights
+    double step = total / nOut;
+    double u    = m_rng.uniform(0.0, step);
+    m_parPosNext.create(nOut,4,CV_64F);
+    for (int i = 0, j = 0; i < nOut; ++i, u += step)
+    {
+        while (j < nIn - 1 && m_cumw[j] < u)
+        {
+            ++j;
+        }
+        const double *pParent = par_pos.ptr<double>(j);
+        const double *pNoise  = m_noise.ptr<double>(i);
+        double *pParPos       = m_parPosNext.ptr<double>(i);
+        double x = *pParent + *pNoise;
+        double y = *(pParent+1) + *(pNoise+1);
+        double w = *(pParent+2) - *pParent + *(pNoise+2);
+        double h = *(pParent+3) - *(pParent+1) + *(pNoise+3);
+        *pParPos     = x;
+        *(pParPos+1) = y;
+        *(pParPos+2) = x + w;
+        *(pParPos+3) = y + h;
+    }
+    cv::swap(par_pos, m_parPosNext);
+}
+/***********************************************************/
+int Cparticle::KLDParticleNum(const Parameter &para, double total)
+{
+    //count the bins of [x,y,w,h] space occupied by the parents that a
+    //resampling with the largest particle count would draw
+    int nIn      = par_pos.rows;
+    double step  = total / para.maxParticles;
+    double u     = step / 2;
+    double bin   = para.kldBin;
+    //the four bin indices of a particle packed into one key, 16 bits each
+    m_kldKeys.resize(para.maxParticles);
+    for (int i = 0, j = 0; i < para.maxParticles; ++i, u += step)
+    {
+        while (j < nIn - 1 && m_cumw[j] < u)
+        {
+            ++j;
+        }
+        const double *p = par_pos.ptr<double>(j);
+        unsigned long long key = (unsigned short)(int)floor(*p / bin);
+        key = key << 16 | (unsigned short)(int)floor(*(p+1) / bin);
+        key = key << 16 | (unsigned short)(int)floor((*(p+2) - *p) / bin);
+        key = key << 16 | (unsigned short)(int)floor((*(p+3) - *(p+1)) / bin);
+        m_kldKeys[i] = key;
+    }
+    sort(m_kldKeys.begin(), m_kldKeys.end());
+    //KLD-sampling bound: enough particles so that the KL divergence between
+    //the sample-based and the true posterior stays below kldEpsilon with
+    //probability given by the normal quantile kldZ
+    int k = (int)(unique(m_kldKeys.begin(), m_kldKeys.end()) - m_kldKeys.begin());
+    int n = para.minParticles;
+    if (k > 1)
+    {
+        double a = 2.0 / (9.0 * (k - 1));
+        double b = 1.0 - a + sqrt(a) * para.kldZ;
+        n = (int)ceil((k - 1) / (2.0 * para.kldEpsilon) * b * b * b);
+    }
+    return min(max(n, para.minParticles), para.maxParticles);
 }
-
-
@@ -19,6 +19,7 @@
 #include "debug.h"
 #include "covImage.h"
 #include "SParater.h"
+#include "ParticleBuffer.h"
 #include <queue>
 
 #pragma warning(disable : 4244 4996)
@@ -26,35 +27,52 @@
 class Cparticle
 {
 public:
+    /* the particle set belongs to the target so that several targets can be
+    tracked at the same time. It is left empty in candidate particles. */
     /* position of all particles*/
-    static Mat par_pos;
+    Mat par_pos;
     /* store the distance between particle with target*/
-    static Mat par_dis;
+    Mat par_dis;
     /* probability */
-    static Mat par_prob,sum_prob;
+    Mat par_prob,sum_prob;
     /* standard deviation*/
-    static Mat stddevm;
+    Mat stddevm;
     /* position of particle. 1*4 matrix. [x1,y1,x2,y2] */
     Mat m_pos;
     /* covariance matrices */
     vector<Mat> m_cmat; 
     /* logm of covariance matrices*/
     vector<Mat> m_logmCmat;
+    /* m_logmCmat packed by ParticleBuffer::packlogm, 1 x dim*(dim+1)/2 each */
+    vector<Mat> m_logmPacked;
     /* library of templates*/
     /* store the covariance matrices in nine modes
     previous para.templateNo frames*/
     deque<vector<Mat>> m_tmplib;
+    /* the templates of m_tmplib packed by ParticleBuffer::packlogm. Row t of
+    m_tmplPacked[i] is template t in mode i; m_tmplNorm2[i] holds the squared
+    norms of the rows */
+    vector<Mat> m_tmplPacked;
+    vector<Mat> m_tmplNorm2;
     /* image patch of templates*/
     vector<Mat> templatePatch;
+    /* cheap descriptor of the target for the cascade, see ParticleBuffer::calcmean */
+    Mat m_meanDesc;
+    /* descriptors of the candidate particles, reused across frames */
+    ParticleBuffer m_candidates;
+    /* random number generator of this tracker. Seeded with para.seed so
+    that a run can be replayed exactly */
+    RNG m_rng;
+    /* distance map of the last dense search, one entry per window */
+    Mat m_dismap;
+    /* work space of the resampling, reused across frames */
+    vector<double> m_cumw;
+    Mat m_noise;
+    Mat m_parPosNext;
+    /* occupied bins of KLDParticleNum, reused across frames */
+    vector<unsigned long long> m_kldKeys;
 
 public:
-    /* constructor 1: candidate particles*/
-    Cparticle(CovImage &cim,Mat &pos,Parameter& para)
-    {
-        m_pos = pos.clone();
-        calccovmat(cim,para);
-        logm();  
-    }
 /* constructor 2:  initialization of the target in 1st frame*/
 //     Cparticle(CovImage &cim, Parameter para){
 //         int nModes = (int)(para.v.size());
@@ -70,19 +88,40 @@ public:
     Cparticle(string filename, Parameter& para, Mat &pos_gt)
     {
         cerr<<"Creating target...";
-        m_tmplib.resize(para.templateNo);
+        m_tmplib.resize(1);
         templatePatch.resize(para.templateNo);
         //construct target
         m_pos = pos_gt.row(0);
         CovImage covimg_init(filename,m_pos);
-        calccovmat(covimg_init,para);
+        InitTarget(covimg_init,para);
+    }
+
+    /* constructor 4: create target from a frame that has already been loaded,
+        e.g. the first frame shared by several targets*/
+    Cparticle(CovImage &cim, Parameter& para, Mat &pos)
+    {
+        cerr<<"Creating target...";
+        m_tmplib.resize(1);
+        templatePatch.resize(para.templateNo);
+        m_pos = pos.clone();
+        InitTarget(cim,para);
+    }
+
+private:
+    /* build the template model of the target at m_pos and draw the first
+        set of particles*/
+    void InitTarget(CovImage &cim, Parameter& para)
+    {
+        m_rng = RNG(para.seed != 0 ? (uint64)para.seed : (uint64)getTickCount());
+        calccovmat(cim,para);
         logm();
+        calcmeandesc(cim,para);
         //cout<<m_logmCmat[0]<<endl;
 
         //save image patch and template model
         //currently only one template
         templatePatch[0] = 
-            covimg_init.im_in.colRange(m_pos.at<double>(0),
+            cim.im_in.colRange(m_pos.at<double>(0),
             m_pos.at<double>(2)).rowRange(
             m_pos.at<double>(1),
             m_pos.at<double>(3));
@@ -91,6 +130,7 @@ public:
             // cout<<m_logmCmat[j]<<endl;
             m_tmplib[0][j] = m_logmCmat[j].clone();
         }
+        packTemplates();
 
         cerr<<"Done!"<<endl;
 
@@ -110,15 +150,26 @@ public:
     /*  calculate the covariance matrices of three modes
     */
     void calc3covmat(CovImage &cim, vector<vector<int>> &v);
+    /*  calculate the cheap descriptor of the target used by the cascade
+    */
+    void calcmeandesc(CovImage &cim, Parameter &para);
     /*  same as Matlab::logm but this function has only been tested on covariance matrix
     */
     void logm();
-    /* calculate the distance between particles
+    /* calculate the descriptors of particle k in m_candidates and its
+    distance to the target
+    */
+    void ParticleProcess(CovImage &cim, Parameter &para, int k);
+    /* distance between the target and particle k of buf in mode i, using the
+    nearest template when the library holds more than one
     */
-    void ParticleProcess(Cparticle &tarpar, int k);
+    double CandidateDistance(ParticleBuffer &buf, int k, int i);
     /* calculate the probability
     */
     void NormProb();
+    /* pack the template library for the nearest-template search
+    */
+    void packTemplates();
     /* update model
     */
     void updateModel(CovImage &covimg,Parameter &para, int frameNo);
@@ -131,6 +182,10 @@ public:
     /*resampling
      */
     void ResampleParticle(Parameter &para);
+    /*number of particles for the next frame by KLD-sampling. Called by
+     ResampleParticle once m_cumw holds the cumulative weights (sum total)
+     */
+    int KLDParticleNum(const Parameter &para, double total);
     
 };
 
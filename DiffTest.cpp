@@ -0,0 +1,355 @@
+/* Differential test of the covariance and logm kernels against brute-force
+references. Run as "Test6 difftest [trials=40] [seed=1] [cov_tol=1e-9]
+[logm_tol=1e-7] [jpeg_tol=1e-2]"; it is also run after every build.
+
+For 1-channel (dim 7) and 3-channel (dim 17) images it compares
+  - the features of a search area with those of the whole frame,
+  - CovImage::covMatrix on random sub-pixel rectangles, on a random feature
+    image integrated as a whole and on a random frame integrated over the
+    search area only,
+  - Cparticle::calc9covmat/calc3covmat and Cparticle::logm,
+  - ParticleBuffer::calccovmat and ParticleBuffer::logm, with and without
+    the quadrant cache,
+with the covariance summed directly over the pixels and with a logm built
+from an eigen decomposition.
+
+When built with COV_USE_TURBOJPEG it also compares CovImage::decodeROI, and
+the features of its search areas, with a whole decode of the same JPEG file
+by imread, in colour and in greyscale. jpeg_tol allows for the rounding of
+the IDCT of OpenCV's own libjpeg; with the same library they are equal.
+
+Errors are relative Frobenius norms. Every failure is printed and the exit
+code is the number of failures; an unknown argument exits with 1.
+*/
+
+#include "Test6.h"
+
+/* settings and state of the test */
+struct DiffConfig
+{
+    int trials;
+    int seed;
+    double covTol;
+    double logmTol;
+    double jpegTol;
+    int checks;
+    int failures;
+};
+
+/* ------------------------------------------------------------ */
+
+/* record one comparison, print it when the error is above tol */
+static void Check(DiffConfig &cfg, const string &what, const Mat &got, const Mat &ref, double tol)
+{
+    ++cfg.checks;
+    double err = norm(got - ref) / max(norm(ref), 1e-300);
+    if (!(err <= tol))
+    {
+        ++cfg.failures;
+        cerr<<"[FAIL] "<<what<<": relative error "<<err<<" > "<<tol<<endl;
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+/* covariance of the pixels of feat in the union of the boxes (x1,y1,x2,y2),
+summed directly. Box coordinates may be sub-pixel: the box covers
+[x1,x2+1) x [y1,y2+1) and every pixel is weighted by its overlap with it,
+which is what the bilinear interpolation of the integral image computes.
+*/
+static Mat RefCovariance(const Mat &feat, const vector<Vec4d> &boxes)
+{
+    int dim = feat.channels();
+    Mat prod = Mat::zeros(dim, dim, CV_64F);
+    Mat sum  = Mat::zeros(dim, 1, CV_64F);
+    double N = 0;
+    for (int b = 0; b < boxes.size(); ++b)
+    {
+        double x1 = boxes[b][0], y1 = boxes[b][1];
+        double x2 = boxes[b][2] + 1, y2 = boxes[b][3] + 1;
+        N += (x2 - x1) * (y2 - y1);
+        for (int r = (int)floor(y1); r < y2; ++r)
+        {
+            double oy = min(r + 1.0, y2) - max((double)r, y1);
+            for (int c = (int)floor(x1); c < x2; ++c)
+            {
+                double w = oy * (min(c + 1.0, x2) - max((double)c, x1));
+                const double *f = feat.ptr<double>(r) + c * dim;
+                for (int i = 0; i < dim; ++i)
+                {
+                    double *pprod = prod.ptr<double>(i);
+                    for (int j = 0; j < dim; ++j)
+                    {
+                        pprod[j] += w * f[i] * f[j];
+                    }
+                    sum.at<double>(i) += w * f[i];
+                }
+            }
+        }
+    }
+    return prod / (N - 1) - sum * sum.t() / (N * (N - 1));
+}
+
+/* ------------------------------------------------------------ */
+
+/* logm of a symmetric positive definite matrix from its eigen decomposition */
+static Mat RefLogm(const Mat &cov)
+{
+    Mat evals, evecs;
+    eigen(cov, evals, evecs);
+    Mat logd = Mat::zeros(cov.rows, cov.rows, CV_64F);
+    for (int i = 0; i < cov.rows; ++i)
+    {
+        logd.at<double>(i, i) = log(evals.at<double>(i));
+    }
+    return evecs.t() * logd * evecs;
+}
+
+/* ------------------------------------------------------------ */
+
+/* covariance references of all modes of the integer box pos */
+static vector<Mat> RefModes(const Mat &feat, Parameter &para, const double *pos)
+{
+    int qx1[4], qy1[4], qx2[4], qy2[4];
+    if (para.nModes == 9)
+    {
+        utils::getQuadrants(pos[0], pos[1], pos[2], pos[3], qx1, qy1, qx2, qy2);
+    }
+    else
+    {
+        utils::getVerticalHalf(pos[0], pos[1], pos[2], pos[3], qx1, qy1, qx2, qy2);
+    }
+    vector<vector<int>> &v = para.nModes == 9 ? para.v9 : para.v3;
+    vector<Mat> refs(v.size());
+    for (int i = 0; i < v.size(); ++i)
+    {
+        vector<Vec4d> boxes;
+        for (int j = 0; j < v[i].size(); ++j)
+        {
+            int q = v[i][j];
+            boxes.push_back(Vec4d(qx1[q], qy1[q], qx2[q], qy2[q]));
+        }
+        refs[i] = RefCovariance(feat, boxes);
+    }
+    return refs;
+}
+
+/* ------------------------------------------------------------ */
+
+/* random sub-pixel box of at least minSize pixels inside [lo, hi) */
+static Vec4d RandomBox(RNG &rng, const vector<int> &area, double minSize)
+{
+    double w  = rng.uniform(minSize, (area[2] - area[0]) * 0.8);
+    double h  = rng.uniform(minSize, (area[3] - area[1]) * 0.8);
+    double x1 = rng.uniform((double)area[0], area[2] - w - 1);
+    double y1 = rng.uniform((double)area[1], area[3] - h - 1);
+    return Vec4d(x1, y1, x1 + w - 1, y1 + h - 1);
+}
+
+/* ------------------------------------------------------------ */
+
+/* covMatrix on random sub-pixel boxes of the integrated area of cim */
+static void CheckCovMatrix(DiffConfig &cfg, CovImage &cim, RNG &rng,
+    const vector<int> &area, const string &label)
+{
+    for (int t = 0; t < cfg.trials; ++t)
+    {
+        Vec4d box = RandomBox(rng, area, 4);
+        double Npixels;
+        Mat cov = cim.covMatrix(box[0], box[1], box[2], box[3], Npixels);
+        stringstream what;
+        what<<label<<" covMatrix "<<Mat(box).t();
+        Check(cfg, what.str(), cov, RefCovariance(cim.featimage, vector<Vec4d>(1, box)), cfg.covTol);
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+/* mode covariances and logm of the target and of the particle buffer */
+static void CheckModes(DiffConfig &cfg, CovImage &cim, Parameter &para, RNG &rng,
+    const string &label)
+{
+    vector<int> &area = cim.mSearchArea;
+    Vec4d box0 = RandomBox(rng, area, 8);
+    Mat pos = (Mat_<double>(1,4)<< floor(box0[0]), floor(box0[1]), floor(box0[2]), floor(box0[3]));
+    Cparticle tarpar(cim, para, pos);
+    Parameter pbuf = para;
+    pbuf.nParticles = 2;
+    stringstream sl;
+    sl<<label<<" "<<para.nModes<<" modes";
+    for (int t = 0; t < cfg.trials; ++t)
+    {
+        Vec4d box = RandomBox(rng, area, 8);
+        double *p = tarpar.m_pos.ptr<double>(0);
+        for (int j = 0; j < 4; ++j)
+        {
+            p[j] = floor(box[j]);
+        }
+        stringstream what;
+        what<<sl.str()<<" box "<<tarpar.m_pos;
+        vector<Mat> refs = RefModes(cim.featimage, para, p);
+        //target
+        tarpar.calccovmat(cim, para);
+        tarpar.logm();
+        for (int i = 0; i < refs.size(); ++i)
+        {
+            stringstream mode;
+            mode<<" mode "<<i;
+            Mat reflogm = RefLogm(refs[i]);
+            Check(cfg, what.str() + mode.str() + " calccovmat", tarpar.m_cmat[i], refs[i], cfg.covTol);
+            Check(cfg, what.str() + mode.str() + " logm", tarpar.m_logmCmat[i], reflogm, cfg.logmTol);
+        }
+        //particle buffer, the second particle hits the quadrant cache
+        for (int memo = 0; memo <= 1; ++memo)
+        {
+            pbuf.memo = memo;
+            ParticleBuffer &buf = tarpar.m_candidates;
+            buf.reserve(pbuf, cim.dim);
+            for (int k = 0; k < 2; ++k)
+            {
+                buf.calccovmat(cim, pbuf, p, k);
+                buf.logm(k);
+                for (int i = 0; i < refs.size(); ++i)
+                {
+                    stringstream mode;
+                    mode<<" mode "<<i<<" buffer memo "<<memo<<" particle "<<k;
+                    Mat reflogm = RefLogm(refs[i]);
+                    Mat packed(1, buf.logmPacked[i].cols, CV_64F);
+                    ParticleBuffer::packlogm(reflogm, packed.ptr<double>(0));
+                    Check(cfg, what.str() + mode.str() + " calccovmat", buf.covmat(k, i), refs[i], cfg.covTol);
+                    Check(cfg, what.str() + mode.str() + " logm", buf.logmPacked[i].row(k), packed, cfg.logmTol);
+                }
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+#ifdef COV_USE_TURBOJPEG
+/* decode random search areas of a JPEG copy of frame by regions and compare
+them with imread of the whole file */
+static void CheckDecodeROI(DiffConfig &cfg, RNG &rng, const Mat &frame, const string &label)
+{
+    string filename = "difftest_roi.jpg";
+    if (!imwrite(filename, frame))
+    {
+        ++cfg.checks;
+        ++cfg.failures;
+        cerr<<"[FAIL] "<<label<<": cannot write "<<filename<<endl;
+        return;
+    }
+    for (int g = 0; g < (frame.channels() == 3 ? 2 : 1); ++g)
+    {
+        bool grey = g == 1;
+        Mat whole = imread(filename, grey ? 0 : -1);
+        for (int t = 0; t < cfg.trials; ++t)
+        {
+            double w  = rng.uniform(8, 48), h = rng.uniform(8, 48);
+            double x1 = rng.uniform(0., frame.cols - w), y1 = rng.uniform(0., frame.rows - h);
+            Mat tarpos = (Mat_<double>(1,4)<< x1, y1, x1 + w, y1 + h);
+            stringstream what;
+            what<<label<<(grey ? " grey" : "")<<" decodeROI ["<<x1<<","<<y1<<","<<x1+w<<","<<y1+h<<"]";
+            //the decoded rows and columns of mWork, and nothing else
+            CovImage cim(frame, tarpos);
+            ++cfg.checks;
+            if (!cim.decodeROI(filename, vector<Mat>(1, tarpos), grey))
+            {
+                ++cfg.failures;
+                cerr<<"[FAIL] "<<what.str()<<": not decoded by regions"<<endl;
+                continue;
+            }
+            Mat got, ref, outside = cim.im_in.clone();
+            cim.im_in(cim.mWork).convertTo(got, CV_64F);
+            whole(cim.mWork).convertTo(ref, CV_64F);
+            Check(cfg, what.str(), got, ref, cfg.jpegTol);
+            outside(cim.mWork).setTo(Scalar::all(0));
+            Check(cfg, what.str() + " outside", Mat(1, 1, CV_64F, Scalar(countNonZero(outside.reshape(1)))),
+                Mat::zeros(1, 1, CV_64F), 0);
+            //the features of the search area follow the decoded pixels
+            CovImage roi(filename, tarpos, grey, true), full(filename, tarpos, grey, false);
+            vector<int> &sa = roi.mSearchArea;
+            Rect sarect(sa[0], sa[1], sa[2] - sa[0], sa[3] - sa[1]);
+            Check(cfg, what.str() + " features", roi.featimage(sarect), full.featimage(sarect), cfg.jpegTol);
+        }
+    }
+    remove(filename.c_str());
+}
+#endif
+
+/* ------------------------------------------------------------ */
+
+int maindifftest(int argc, char** argv)
+{
+    map<string,double> args;
+    args["trials"]   = 40;
+    args["seed"]     = 1;
+    args["cov_tol"]  = 1e-9;
+    args["logm_tol"] = 1e-7;
+    args["jpeg_tol"] = 1e-2;
+    //a misspelt key would run the gate with the defaults
+    if (!utils::ParseArgs(argc, argv, args))
+    {
+        return 1;
+    }
+    DiffConfig cfg;
+    cfg.trials  = (int)args["trials"];
+    cfg.seed    = (int)args["seed"];
+    cfg.covTol  = args["cov_tol"];
+    cfg.logmTol = args["logm_tol"];
+    cfg.jpegTol = args["jpeg_tol"];
+    cfg.checks  = cfg.failures = 0;
+    RNG rng(cfg.seed);
+
+    Parameter para;
+    para.file = "";
+    utils::InitPara(para);
+    para.seed     = cfg.seed;
+    para.memo     = 0;
+    para.abandonK = 0;
+    cerr<<endl;
+
+    int channels[2] = {1, 3};
+    for (int c = 0; c < 2; ++c)
+    {
+        int nch = channels[c];
+        stringstream label;
+        label<<nch<<"-channel";
+        //random feature image, integrated as a whole
+        Mat feat(48, 64, CV_64FC(nch*5 + 2));
+        rng.fill(feat, RNG::UNIFORM, Scalar::all(-1), Scalar::all(1));
+        CovImage cimFeat(feat);
+        vector<int> whole(4);
+        whole[0] = 0; whole[1] = 0; whole[2] = feat.cols; whole[3] = feat.rows;
+        CheckCovMatrix(cfg, cimFeat, rng, whole, label.str() + " feature image");
+
+        //random frame, integrated over the search area of a target
+        Mat frame(120, 160, nch == 1 ? CV_8UC1 : CV_8UC3);
+        rng.fill(frame, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+        Mat tarpos = (Mat_<double>(1,4)<< 50, 35, 100, 80);
+        CovImage cim(frame, tarpos);
+        //only the search area and its halo are converted, their features
+        //must be those of the whole frame
+        Mat wholepos = (Mat_<double>(1,4)<< 0, 0, frame.cols, frame.rows);
+        CovImage cimWhole(frame, wholepos);
+        vector<int> &sa = cim.mSearchArea;
+        Rect sarect(sa[0], sa[1], sa[2] - sa[0], sa[3] - sa[1]);
+        Check(cfg, label.str() + " search area features", cim.featimage(sarect),
+            cimWhole.featimage(sarect), 0);
+        CheckCovMatrix(cfg, cim, rng, cim.mSearchArea, label.str() + " search area");
+#ifdef COV_USE_TURBOJPEG
+        //a smooth frame, which JPEG keeps close to the original
+        Mat smooth;
+        GaussianBlur(frame, smooth, Size(7, 7), 2);
+        CheckDecodeROI(cfg, rng, smooth, label.str());
+#endif
+        int modes[2] = {9, 3};
+        for (int m = 0; m < 2; ++m)
+        {
+            para.nModes = modes[m];
+            CheckModes(cfg, cim, para, rng, label.str());
+        }
+    }
+    cout<<"difftest: "<<cfg.checks<<" checks, "<<cfg.failures<<" failures"<<endl;
+    return cfg.failures;
+}
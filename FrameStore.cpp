@@ -0,0 +1,300 @@
+/*
+* Pre-decoded frame store of a sequence.
+*/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "FrameStore.h"
+#include "debug.h"
+#include "Profiler.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#define FSEEK64 _fseeki64
+#define FTELL64 _ftelli64
+#define STAT64 _stat64
+#define STAT64_T struct __stat64
+#else
+#include <sys/mman.h>
+#define FSEEK64 fseeko
+#define FTELL64 ftello
+#define STAT64 stat
+#define STAT64_T struct stat
+#endif
+
+/* frames decoded in parallel before they are written */
+#define PACK_BLOCK 32
+
+/***********************************************************/
+/* size and modification time of an image file, -1 and 0 when it is missing */
+static void SourceStamp(const string &filename, long long *stamp)
+{
+    STAT64_T st;
+    if (STAT64(filename.c_str(), &st) != 0)
+    {
+        stamp[0] = -1;
+        stamp[1] = 0;
+        return;
+    }
+    stamp[0] = (long long)st.st_size;
+    stamp[1] = (long long)st.st_mtime;
+}
+/***********************************************************/
+/* the image as stored: decoded, and converted as in imin_rgb2lab() */
+static Mat PackedFrame(const string &filename, bool lab)
+{
+    Mat im = imread(filename, -1);
+    if (lab && im.channels() == 3)
+    {
+        Mat tmp, labim;
+        im.convertTo(tmp, CV_32F);
+        tmp *= 1./255;
+        cvtColor(tmp, labim, CV_BGR2Lab);
+        return labim;
+    }
+    return im;
+}
+/***********************************************************/
+bool FrameStore::pack(const vector<string> &filenames, const string &path, bool lab)
+{
+    int nFrames = (int)filenames.size();
+    ofstream out(path.c_str(), ios::trunc | ios::binary);
+    if (!out.is_open() || nFrames == 0)
+    {
+        ERROR_OUT__<<" cannot write the frame store "<<path<<endl;
+        return false;
+    }
+    cerr<<"Packing "<<nFrames<<" frames into "<<path<<"...";
+    vector<long long> offsets(nFrames, 0);
+    vector<long long> stamps(2 * nFrames);
+    for (int i = 0; i < nFrames; ++i)
+    {
+        SourceStamp(filenames[i], &stamps[2 * i]);
+    }
+    int32_t header[HEADER_BYTES / 4];
+    memset(header, 0, sizeof(header));
+    long long pos = HEADER_BYTES + 3 * (long long)nFrames * sizeof(long long);
+    int rows = 0, cols = 0, type = -1, nWritten = 0;
+    for (int start = 0; start < nFrames; start += PACK_BLOCK)
+    {
+        int n = min(PACK_BLOCK, nFrames - start);
+        vector<Mat> block(n);
+        #pragma omp parallel for schedule(dynamic,1)
+        for (int k = 0; k < n; ++k)
+        {
+            block[k] = PackedFrame(filenames[start + k], lab);
+        }
+        for (int k = 0; k < n; ++k)
+        {
+            Mat &im = block[k];
+            if (type < 0 && !im.empty())
+            {
+                rows = im.rows; cols = im.cols; type = im.type();
+            }
+            if (im.empty() || im.rows != rows || im.cols != cols || im.type() != type)
+            {
+                ERROR_OUT__<<" "<<filenames[start + k]<<" is missing or differs from the first frame, not stored"<<endl;
+                continue;
+            }
+            pos = (pos + FRAME_ALIGN - 1) / FRAME_ALIGN * FRAME_ALIGN;
+            offsets[start + k] = pos;
+            out.seekp(pos);
+            size_t rowBytes = (size_t)cols * im.elemSize();
+            for (int r = 0; r < rows; ++r)
+            {
+                out.write((const char*)im.ptr(r), rowBytes);
+            }
+            pos += (long long)rowBytes * rows;
+            ++nWritten;
+        }
+    }
+    //header and offsets, once all frames are known
+    memcpy(header, "CVFS", 4);
+    header[1] = VERSION;
+    header[2] = nFrames;
+    header[3] = rows;
+    header[4] = cols;
+    header[5] = type;
+    header[6] = lab && type == CV_32FC3;
+    out.seekp(0);
+    out.write((const char*)header, HEADER_BYTES);
+    out.write((const char*)&offsets[0], nFrames * sizeof(long long));
+    out.write((const char*)&stamps[0], 2 * nFrames * sizeof(long long));
+    out.close();
+    cerr<<"Done!"<<endl;
+    if (nWritten == 0 || out.fail())
+    {
+        ERROR_OUT__<<" the frame store "<<path<<" could not be written"<<endl;
+        remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+/***********************************************************/
+FrameStore::FrameStore(const string &path)
+    : m_path(path), m_status(STORE_MISSING), m_fp(NULL), m_fileSize(0),
+      m_base(NULL), m_mapSize(0), m_mapping(NULL),
+      m_frames(0), m_rows(0), m_cols(0), m_type(0), m_lab(false)
+{
+    omp_init_lock(&m_lock);
+    m_fp = fopen(path.c_str(), "rb");
+    if (!m_fp)
+    {
+        //a store locked or denied is not packed again
+        if (errno != ENOENT)
+        {
+            ERROR_OUT__<<" cannot open the frame store "<<path<<endl;
+            m_status = STORE_UNREADABLE;
+        }
+        return;
+    }
+    FSEEK64(m_fp, 0, SEEK_END);
+    m_fileSize = FTELL64(m_fp);
+    FSEEK64(m_fp, 0, SEEK_SET);
+    //check the header and the offset table
+    int32_t header[HEADER_BYTES / 4];
+    if (fread(header, HEADER_BYTES, 1, m_fp) != 1 || memcmp(header, "CVFS", 4) != 0 ||
+        header[1] != VERSION || header[2] <= 0 ||
+        m_fileSize < HEADER_BYTES + 3 * (long long)header[2] * (long long)sizeof(long long))
+    {
+        ERROR_OUT__<<" "<<path<<" is not a frame store of version "<<VERSION<<endl;
+        m_status = STORE_INVALID;
+        return;
+    }
+    m_frames = header[2];
+    m_rows   = header[3];
+    m_cols   = header[4];
+    m_type   = header[5];
+    m_lab    = header[6] != 0;
+    m_offsets.resize(m_frames);
+    m_stamps.resize(2 * m_frames);
+    if (fread(&m_offsets[0], sizeof(long long), m_frames, m_fp) != (size_t)m_frames ||
+        fread(&m_stamps[0], sizeof(long long), 2 * m_frames, m_fp) != 2 * (size_t)m_frames)
+    {
+        ERROR_OUT__<<" the offsets of "<<path<<" are truncated"<<endl;
+        m_status = STORE_INVALID;
+        return;
+    }
+    m_status = STORE_OK;
+    if (!mapFile())
+    {
+        unmap();
+        cerr<<"The frame store "<<path<<" is not mapped, its frames are read one at a time"<<endl;
+    }
+}
+/***********************************************************/
+FrameStore::~FrameStore()
+{
+    unmap();
+    if (m_fp)
+    {
+        fclose(m_fp);
+    }
+    omp_destroy_lock(&m_lock);
+}
+/***********************************************************/
+bool FrameStore::mapFile()
+{
+    //the whole file must fit in the address space with room to spare, which
+    //rules out 32-bit programs
+    if (sizeof(void*) < 8 || m_fileSize <= 0)
+    {
+        return false;
+    }
+    m_mapSize = (size_t)m_fileSize;
+#ifdef _WIN32
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(m_fp));
+    //copy-on-write view, the frames can be drawn on
+    m_mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (m_mapping)
+    {
+        m_base = (char*)MapViewOfFile((HANDLE)m_mapping, FILE_MAP_COPY, 0, 0, 0);
+    }
+#else
+    //copy-on-write mapping, the frames can be drawn on
+    void *p = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(m_fp), 0);
+    m_base = p == MAP_FAILED ? NULL : (char*)p;
+#endif
+    return m_base != NULL;
+}
+/***********************************************************/
+void FrameStore::unmap()
+{
+#ifdef _WIN32
+    if (m_base)
+    {
+        UnmapViewOfFile(m_base);
+    }
+    if (m_mapping)
+    {
+        CloseHandle((HANDLE)m_mapping);
+    }
+#else
+    if (m_base)
+    {
+        munmap(m_base, m_mapSize);
+    }
+#endif
+    m_base    = NULL;
+    m_mapping = NULL;
+    m_mapSize = 0;
+}
+/***********************************************************/
+Mat FrameStore::frame(int i)
+{
+    PROF_SCOPE(PROF_DECODE);
+    if (!isOpen() || i < 0 || i >= m_frames || m_offsets[i] <= 0)
+    {
+        return Mat();
+    }
+    size_t bytes = (size_t)m_rows * m_cols * CV_ELEM_SIZE(m_type);
+    if (m_offsets[i] + (long long)bytes > m_fileSize)
+    {
+        ERROR_OUT__<<" frame "<<i+1<<" of "<<m_path<<" is truncated"<<endl;
+        return Mat();
+    }
+    if (m_base)
+    {
+        return Mat(m_rows, m_cols, m_type, m_base + m_offsets[i]);
+    }
+    //one file position shared by all threads
+    Mat im(m_rows, m_cols, m_type);
+    omp_set_lock(&m_lock);
+    bool ok = FSEEK64(m_fp, m_offsets[i], SEEK_SET) == 0 && fread(im.data, bytes, 1, m_fp) == 1;
+    omp_unset_lock(&m_lock);
+    if (!ok)
+    {
+        ERROR_OUT__<<" cannot read frame "<<i+1<<" of "<<m_path<<endl;
+        return Mat();
+    }
+    return im;
+}
+/***********************************************************/
+bool FrameStore::matches(const vector<string> &filenames) const
+{
+    if (!isOpen() || (int)filenames.size() != m_frames)
+    {
+        return false;
+    }
+    for (int i = 0; i < m_frames; ++i)
+    {
+        long long stamp[2];
+        SourceStamp(filenames[i], stamp);
+        if (stamp[0] != m_stamps[2 * i] || stamp[1] != m_stamps[2 * i + 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
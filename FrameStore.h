@@ -0,0 +1,107 @@
+#ifndef __COV_FRAME_STORE_H__
+#define __COV_FRAME_STORE_H__
+/*
+* Pre-decoded frames of a sequence in one raw file, written once by pack()
+* and memory-mapped by the reader, so that repeated runs neither decode nor
+* copy the images. frame(i) is a cv::Mat header on the mapping. The mapping
+* is copy-on-write: drawing on a frame copies the touched pages and never
+* changes the file. In a 32-bit program, or when the file cannot be mapped,
+* frame(i) reads the frame into its own cv::Mat instead, so that a store
+* larger than the address space is still used.
+*
+* Layout, little-endian:
+*   header of HEADER_BYTES: "CVFS", then int32 version, frames, rows, cols,
+*                           OpenCV type and content (0 BGR, 1 Lab), zeros
+*   int64 offset of every frame from the start of the file, 0 when the
+*   image could not be decoded
+*   int64 size and int64 modification time of every image file as packed,
+*   -1 and 0 when it could not be found
+*   frames of rows*cols pixels, each starting on a FRAME_ALIGN boundary
+* BGR frames are the images as decoded by imread (CV_8UC3 or CV_8UC1). Lab
+* frames hold the CV_32FC3 Lab conversion of imin_rgb2lab(), so that it is
+* skipped as well; greyscale sequences stay CV_8UC1.
+* The sizes and times tell matches() whether the images changed since the
+* store was packed.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <omp.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+class FrameStore
+{
+public:
+    static const int VERSION = 2;
+    static const int HEADER_BYTES = 64;
+    static const int FRAME_ALIGN = 4096;
+
+    /* decode the image files in order and write them to path, converted to
+    Lab when lab is set. Returns false when nothing usable was written. */
+    static bool pack(const vector<string> &filenames, const string &path, bool lab);
+
+    /* state of a store after opening */
+    enum Status
+    {
+        STORE_OK = 0,       // frames can be read
+        STORE_MISSING,      // there is no file at path
+        STORE_INVALID,      // the file is not a store of this version
+        STORE_UNREADABLE    // the file exists but cannot be opened
+    };
+
+    /* open the store at path and map it when the address space allows;
+    status() tells why isOpen() is false */
+    FrameStore(const string &path);
+    /* unmap the store, the frames returned by frame() must not be used after */
+    ~FrameStore();
+
+    inline Status status() const { return m_status; }
+    inline bool isOpen() const { return m_status == STORE_OK; }
+    /* true when frame() returns views of the mapping rather than copies */
+    inline bool isMapped() const { return m_base != NULL; }
+    inline int frames() const { return m_frames; }
+    /* true when the frames hold Lab instead of BGR */
+    inline bool isLab() const { return m_lab; }
+    /* frame i, counted from 0; empty when it was not decoded. Can be called
+    from several threads. */
+    Mat frame(int i);
+    /* true when the store was packed from these image files, in this order,
+    and none of them changed size or modification time since */
+    bool matches(const vector<string> &filenames) const;
+
+private:
+    FrameStore(const FrameStore&);
+    FrameStore& operator=(const FrameStore&);
+
+    /* map the whole file, false when it does not fit or mapping fails */
+    bool mapFile();
+    void unmap();
+
+    string m_path;
+    Status m_status;
+    FILE *m_fp;
+    long long m_fileSize;
+    /* mapping of the whole file, NULL when the frames are read */
+    char *m_base;
+    size_t m_mapSize;
+    void *m_mapping;
+    int m_frames;
+    int m_rows;
+    int m_cols;
+    int m_type;
+    bool m_lab;
+    vector<long long> m_offsets;
+    /* size and modification time of every image file, in pairs */
+    vector<long long> m_stamps;
+    /* serialises the reads of unmapped frames */
+    omp_lock_t m_lock;
+};
+
+#endif
@@ -0,0 +1,250 @@
+/*
+* One-pass evaluation of tracking results.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "OPE.h"
+#include "ResultsWriter.h"
+#include "debug.h"
+#include "utils.h"
+
+/* ------------------------------------------------------------ */
+
+static string Extension(const string &path)
+{
+    size_t dot = path.rfind('.');
+    return dot == string::npos ? "" : path.substr(dot);
+}
+
+/* ------------------------------------------------------------ */
+
+/* replace the separators of a line by spaces */
+static void Blank(string &line, const char *separators)
+{
+    for (int i = 0; i < line.size(); ++i)
+    {
+        if (strchr(separators, line[i]))
+        {
+            line[i] = ' ';
+        }
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+bool ope::LoadResults(const string &path, vector<int> &frames, Mat &boxes)
+{
+    frames.clear();
+    vector<double> coords;
+    string ext = Extension(path);
+    if (ext == ".bin")
+    {
+        ifstream inf(path.c_str(), ios::binary);
+        int32_t header[4];
+        if (!inf.read((char*)header, sizeof(header)) || memcmp(header, "CVTR", 4) != 0 ||
+            header[2] != ResultsWriter::RECORD_BYTES)
+        {
+            ERROR_OUT__<<" not a results file "<<path<<endl;
+            return false;
+        }
+        char buf[ResultsWriter::RECORD_BYTES];
+        while (inf.read(buf, ResultsWriter::RECORD_BYTES))
+        {
+            int32_t frame;
+            double box[4];
+            memcpy(&frame, buf, 4);
+            memcpy(box, buf + 8, 32);
+            frames.push_back(frame);
+            coords.insert(coords.end(), box, box + 4);
+        }
+    }
+    else
+    {
+        ifstream inf(path.c_str());
+        if (!inf.is_open())
+        {
+            ERROR_OUT__<<" cannot open "<<path<<endl;
+            return false;
+        }
+        //the first line is the CSV header or "<file> <dataset>"
+        string line;
+        getline(inf, line);
+        while (getline(inf, line))
+        {
+            //"frame mode [x1, y1, x2, y2]" or "frame,mode,x1,y1,x2,y2,..."
+            Blank(line, "[],");
+            stringstream sline(line);
+            int frame, mode;
+            double box[4];
+            if (sline>>frame>>mode>>box[0]>>box[1]>>box[2]>>box[3])
+            {
+                frames.push_back(frame);
+                coords.insert(coords.end(), box, box + 4);
+            }
+        }
+    }
+    boxes = Mat((int)frames.size(), 4, CV_64F);
+    if (!coords.empty())
+    {
+        memcpy(boxes.ptr<double>(0), &coords[0], coords.size() * sizeof(double));
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+
+Mat ope::LoadGroundTruth(const string &path)
+{
+    ifstream inf(path.c_str());
+    if (!inf.is_open())
+    {
+        ERROR_OUT__<<" cannot open "<<path<<endl;
+        return Mat();
+    }
+    vector<double> coords;
+    string line;
+    while (getline(inf, line))
+    {
+        Blank(line, ",\t\r");
+        stringstream sline(line);
+        double x, y, w, h;
+        if (!(sline>>x>>y>>w>>h))
+        {
+            //keep the row so that the frames stay aligned
+            x = y = w = h = 0;
+        }
+        //same convention as utils::LoadPosGT
+        coords.push_back(x - 1);
+        coords.push_back(y - 1);
+        coords.push_back(x + w - 1);
+        coords.push_back(y + h - 1);
+    }
+    Mat gt((int)coords.size() / 4, 4, CV_64F);
+    if (!coords.empty())
+    {
+        memcpy(gt.ptr<double>(0), &coords[0], coords.size() * sizeof(double));
+    }
+    return gt;
+}
+
+/* ------------------------------------------------------------ */
+
+void ope::FrameErrors(const vector<int> &frames, const Mat &boxes, const Mat &gt,
+    vector<double> &iou, vector<double> &centreErr)
+{
+    iou.clear();
+    centreErr.clear();
+    for (int n = 0; n < frames.size(); ++n)
+    {
+        int i = frames[n] - 1;
+        if (i < 0 || i >= gt.rows)
+        {
+            continue;
+        }
+        const double *pg = gt.ptr<double>(i);
+        const double *pb = boxes.ptr<double>(n);
+        if (pg[2] <= pg[0] || pg[3] <= pg[1])
+        {
+            continue;
+        }
+        iou.push_back(utils::calcIOUscore(boxes.row(n), gt.row(i)));
+        double dx = (pb[0] + pb[2]) / 2 - (pg[0] + pg[2]) / 2;
+        double dy = (pb[1] + pb[3]) / 2 - (pg[1] + pg[3]) / 2;
+        centreErr.push_back(sqrt(dx*dx + dy*dy));
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+ope::Score ope::Summarise(const string &name, const vector<double> &iou,
+    const vector<double> &centreErr)
+{
+    Score score;
+    score.name    = name;
+    score.nFrames = (int)iou.size();
+    double n = max(score.nFrames, 1);
+    //histogram the errors once, then accumulate the curves
+    int iouHist[OPE_IOU_STEPS] = {0};
+    int errHist[OPE_ERR_STEPS + 1] = {0};
+    double sumIoU = 0, sumErr = 0;
+    for (int j = 0; j < score.nFrames; ++j)
+    {
+        sumIoU += iou[j];
+        sumErr += centreErr[j];
+        //largest threshold t/100 not above the IoU
+        int t = (int)floor(iou[j] * (OPE_IOU_STEPS - 1) + 1e-9);
+        ++iouHist[min(max(t, 0), OPE_IOU_STEPS - 1)];
+        //smallest threshold not below the error
+        int e = (int)ceil(centreErr[j]);
+        ++errHist[min(e, OPE_ERR_STEPS)];
+    }
+    score.meanIoU       = sumIoU / n;
+    score.meanCentreErr = sumErr / n;
+    int above = 0;
+    for (int t = OPE_IOU_STEPS - 1; t >= 0; --t)
+    {
+        above += iouHist[t];
+        score.success[t] = above / n;
+    }
+    int below = 0;
+    for (int t = 0; t < OPE_ERR_STEPS; ++t)
+    {
+        below += errHist[t];
+        score.precision[t] = below / n;
+    }
+    double area = 0;
+    for (int t = 0; t < OPE_IOU_STEPS; ++t)
+    {
+        area += score.success[t];
+    }
+    score.auc    = area / OPE_IOU_STEPS;
+    score.prec20 = score.precision[20];
+    return score;
+}
+
+/* ------------------------------------------------------------ */
+
+ope::Score ope::EvaluateRuns(const vector<string> &runs, const vector<string> &gts,
+    ostream &out)
+{
+    int nRuns = (int)runs.size();
+    vector<vector<double> > iou(nRuns), centreErr(nRuns);
+    vector<Score> scores(nRuns);
+    #pragma omp parallel for schedule(dynamic,1)
+    for (int n = 0; n < nRuns; ++n)
+    {
+        vector<int> frames;
+        Mat boxes;
+        if (ope::LoadResults(runs[n], frames, boxes))
+        {
+            Mat gt = ope::LoadGroundTruth(gts[n]);
+            ope::FrameErrors(frames, boxes, gt, iou[n], centreErr[n]);
+        }
+        scores[n] = ope::Summarise(runs[n], iou[n], centreErr[n]);
+    }
+    //all frames of all runs, as in the OPE plots
+    vector<double> allIoU, allErr;
+    for (int n = 0; n < nRuns; ++n)
+    {
+        allIoU.insert(allIoU.end(), iou[n].begin(), iou[n].end());
+        allErr.insert(allErr.end(), centreErr[n].begin(), centreErr[n].end());
+    }
+    Score overall = ope::Summarise("overall", allIoU, allErr);
+    scores.push_back(overall);
+
+    out<<"run\tframes\tmeanIoU\tcentreErr\tAUC\tprec20"<<endl;
+    for (int n = 0; n < scores.size(); ++n)
+    {
+        Score &s = scores[n];
+        out<<s.name<<"\t"<<s.nFrames<<"\t"<<s.meanIoU<<"\t"<<s.meanCentreErr
+           <<"\t"<<s.auc<<"\t"<<s.prec20<<endl;
+    }
+    return overall;
+}
@@ -0,0 +1,72 @@
+#ifndef __COV_OPE_H__
+#define __COV_OPE_H__
+/*
+* One-pass evaluation (OPE) of tracking results against the ground truth:
+* IoU, centre error, success curve and its AUC, precision curve and the
+* precision at 20 pixels, per sequence and over all frames of all sequences.
+* Boxes are (x1,y1,x2,y2) with 0-based pixel indices, as in utils::LoadPosGT.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+/* thresholds of the success curve: 0, 0.01, ..., 1 */
+#define OPE_IOU_STEPS 101
+/* thresholds of the precision curve in pixels: 0, 1, ..., 50 */
+#define OPE_ERR_STEPS 51
+
+namespace ope
+{
+    /* scores of one sequence, or of all of them */
+    struct Score
+    {
+        string name;
+        int nFrames;
+        double meanIoU;
+        double meanCentreErr;
+        /* success[t]: fraction of frames with IoU >= t/100 */
+        double success[OPE_IOU_STEPS];
+        /* precision[t]: fraction of frames with centre error <= t pixels */
+        double precision[OPE_ERR_STEPS];
+        /* area under the success curve and precision at 20 pixels */
+        double auc;
+        double prec20;
+    };
+
+    /* read a results file written by ResultsWriter in any of its formats,
+    chosen by the extension (.txt, .csv, .bin). frames receives the 1-based
+    frame numbers and boxes one row per frame. Returns false when the file
+    cannot be read.
+    */
+    bool LoadResults(const string &path, vector<int> &frames, Mat &boxes);
+    /* read a ground truth file of x,y,w,h lines separated by commas, tabs
+    or spaces. Row i belongs to frame i+1.
+    */
+    Mat LoadGroundTruth(const string &path);
+
+    /* IoU and centre error of every frame of a run. Frames without a valid
+    ground truth box are skipped.
+    */
+    void FrameErrors(const vector<int> &frames, const Mat &boxes, const Mat &gt,
+        vector<double> &iou, vector<double> &centreErr);
+    /* curves and summary of a set of per-frame errors */
+    Score Summarise(const string &name, const vector<double> &iou,
+        const vector<double> &centreErr);
+
+    /* evaluate the runs[n] against gts[n] in parallel, print one line per
+    run and one for all frames of all runs to out, and return the overall
+    score
+    */
+    Score EvaluateRuns(const vector<string> &runs, const vector<string> &gts,
+        ostream &out);
+}
+
+#endif
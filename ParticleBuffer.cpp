@@ -0,0 +1,322 @@
+/*
+* Compact candidate particle store.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+
+#include <assert.h>
+#include <limits>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define COV_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "ParticleBuffer.h"
+#include "utils.h"
+
+/* number of packed values summed between two checks of the abandon bound */
+#define ABANDON_BLOCK 16
+
+/***********************************************************/
+void ParticleBuffer::reserve(const Parameter &para, int dim)
+{
+    this->nParticles = para.nParticles;
+    this->nModes     = para.nModes;
+    this->dim        = dim;
+    this->abandonK   = para.abandonK;
+    this->memo       = para.memo;
+    cmat.resize(nModes);
+    logmPacked.resize(nModes);
+    active.assign(nModes, 1);
+    bestDis.assign(nModes, priority_queue<double>());
+    for(int i = 0; i < nModes; ++i)
+    {
+        // create() keeps the old memory when the size is unchanged
+        cmat[i].create(nParticles, dim*dim, CV_64F);
+        logmPacked[i].create(nParticles, dim*(dim+1)/2, CV_64F);
+    }
+    meanDesc.create(nParticles, meanLength(nModes, dim), CV_64F);
+    if (memo)
+    {
+        compCache.create(nParticles*4, dim*(dim+1)/2 + dim + 1, CV_64F);
+        nComp = 0;
+        compIndex.clear();
+        boxIndex.clear();
+    }
+    prod.create(dim, dim, CV_64F);
+    sum.create(dim, 1, CV_64F);
+}
+/***********************************************************/
+void ParticleBuffer::setActiveModes(const double *tranRow)
+{
+    for(int i = 0; i < nModes; ++i)
+    {
+        active[i] = tranRow[i] > 0;
+    }
+}
+/***********************************************************/
+void ParticleBuffer::calccovmat(CovImage &cim, Parameter &para, const double *pos, int k)
+{
+    assert(nModes == 9 || nModes == 3);
+    vector<vector<int>> &v = nModes == 9 ? para.v9 : para.v3;
+    int nParts = nModes == 9 ? 4 : 2;
+    int qx1[4], qy1[4], qx2[4], qy2[4];
+    double Npixels[4];
+
+    if(nModes == 9)
+    {
+        utils::getQuadrants(*(pos), *(pos+1), *(pos+2), *(pos+3), qx1, qy1, qx2, qy2);
+    }
+    else
+    {
+        utils::getVerticalHalf(*(pos), *(pos+1), *(pos+2), *(pos+3), qx1, qy1, qx2, qy2);
+    }
+    // component matrices of the parts, from the cache when possible
+    {
+        PROF_SCOPE(PROF_COVARIANCE);
+        for (int i = 0; i < nParts; i++) 
+        {
+            unsigned long long key = rectKey(qx1[i], qy1[i], qx2[i], qy2[i]);
+            if (memo)
+            {
+                ++compLookups;
+                unordered_map<unsigned long long, int>::iterator it = compIndex.find(key);
+                if (it != compIndex.end())
+                {
+                    // unpack the cached component matrices
+                    ++compHits;
+                    const double *pc = compCache.ptr<double>(it->second);
+                    prodM[i].create(dim, dim, CV_64F);
+                    sumM[i].create(dim, 1, CV_64F);
+                    for (int r = 0; r < dim; r++)
+                    {
+                        for (int c = r; c < dim; c++, pc++)
+                        {
+                            prodM[i].at<double>(r,c) = *pc;
+                            prodM[i].at<double>(c,r) = *pc;
+                        }
+                    }
+                    for (int r = 0; r < dim; r++, pc++)
+                    {
+                        sumM[i].at<double>(r) = *pc;
+                    }
+                    Npixels[i] = *pc;
+                    continue;
+                }
+            }
+            cim.covComponentMatrices(qx1[i], qy1[i], qx2[i], qy2[i],
+                prodM[i], sumM[i], Npixels[i]);
+            if (memo && nComp < compCache.rows)
+            {
+                // pack the component matrices into the cache
+                double *pc = compCache.ptr<double>(nComp);
+                for (int r = 0; r < dim; r++)
+                {
+                    const double *pprod = prodM[i].ptr<double>(r);
+                    for (int c = r; c < dim; c++, pc++)
+                    {
+                        *pc = pprod[c];
+                    }
+                }
+                for (int r = 0; r < dim; r++, pc++)
+                {
+                    *pc = sumM[i].at<double>(r);
+                }
+                *pc = Npixels[i];
+                compIndex[key] = nComp++;
+            }
+        }
+    }
+
+    for(int i = 0; i < v.size() ; i++)
+    {
+        if (!active[i])
+        {
+            continue;
+        }
+        prod.setTo(0.0);
+        sum.setTo(0.0);
+        double N = 0;
+        for(int j = 0; j < v[i].size(); j++)
+        {
+            prod += prodM[v[i][j]];
+            sum  += sumM[v[i][j]];
+            N    += Npixels[v[i][j]];
+        }
+        // cmat = prod / (N-1) - sum*sum' / (N*(N-1))
+        double *pcmat       = cmat[i].ptr<double>(k);
+        const double *pprod = prod.ptr<double>(0);
+        const double *psum  = sum.ptr<double>(0);
+        for(int r = 0; r < dim; r++)
+        {
+            for(int c = 0; c < dim; c++, pcmat++, pprod++)
+            {
+                *pcmat = *pprod / (N-1) - psum[r]*psum[c] / (N*(N-1));
+            }
+        }
+    }
+}
+/***********************************************************/
+void ParticleBuffer::logm(int k)
+{
+    PROF_SCOPE(PROF_LOGM);
+    for(int i = 0; i < nModes; i++)
+    {
+        if (!active[i])
+        {
+            continue;
+        }
+        Mat c = covmat(k, i);
+        SVD::compute(c, W, U, V);
+        for(int j = 0; j < dim ;j++)
+        {
+             U(Range(0,dim),Range(j,j+1)) *= log(W.at<double>(j)); 
+        }
+        gemm(U, V, 1.0, Mat(), 0.0, logmFull);
+        packlogm(logmFull, logmPacked[i].ptr<double>(k));
+    }
+}
+/***********************************************************/
+bool ParticleBuffer::reuseBox(const double *pos, int k)
+{
+    if (memo < 2)
+    {
+        return false;
+    }
+    // the descriptors only depend on the box rounded as in calccovmat
+    unsigned long long key = rectKey((int)*pos, (int)*(pos+1),
+        (int)*(pos+2), (int)*(pos+3));
+    ++boxLookups;
+    unordered_map<unsigned long long, int>::iterator it = boxIndex.find(key);
+    if (it == boxIndex.end())
+    {
+        boxIndex[key] = k;
+        return false;
+    }
+    ++boxHits;
+    for (int i = 0; i < nModes; i++)
+    {
+        if (active[i])
+        {
+            Mat cdst = cmat[i].row(k);
+            Mat ldst = logmPacked[i].row(k);
+            cmat[i].row(it->second).copyTo(cdst);
+            logmPacked[i].row(it->second).copyTo(ldst);
+        }
+    }
+    return true;
+}
+/***********************************************************/
+double ParticleBuffer::distance(int k, int i, const double *tarPacked)
+{
+    double bound = numeric_limits<double>::infinity();
+    if (abandonK > 0 && (int)bestDis[i].size() >= abandonK)
+    {
+        bound = bestDis[i].top();
+    }
+    double dis = packedDistance(logmPacked[i].ptr<double>(k), tarPacked,
+        logmPacked[i].cols, bound);
+    if (abandonK > 0)
+    {
+        bestDis[i].push(dis);
+        if ((int)bestDis[i].size() > abandonK)
+        {
+            bestDis[i].pop();
+        }
+    }
+    return dis;
+}
+/***********************************************************/
+double ParticleBuffer::nearestDistance(int k, int i, const Mat &tmpl, const Mat &tmplNorm2)
+{
+    Mat a = logmPacked[i].row(k);
+    gemm(tmpl, a, 1.0, Mat(), 0.0, dots, GEMM_2_T);
+    double a2    = a.dot(a);
+    double best2 = numeric_limits<double>::infinity();
+    const double *pdots  = dots.ptr<double>(0);
+    const double *pnorm2 = tmplNorm2.ptr<double>(0);
+    for(int t = 0; t < tmpl.rows; ++t)
+    {
+        best2 = min(best2, a2 - 2 * pdots[t] + pnorm2[t]);
+    }
+    return sqrt(max(best2, 0.0));
+}
+/***********************************************************/
+void ParticleBuffer::packlogm(const Mat &sym, double *packed)
+{
+    const double sqrt2 = sqrt(2.0);
+    int n = sym.rows;
+    for(int r = 0; r < n; r++)
+    {
+        const double *prow = sym.ptr<double>(r);
+        *(packed++) = prow[r];
+        for(int c = r+1; c < n; c++)
+        {
+            // (sym(r,c) + sym(c,r))/2 symmetrises the result of logm
+            *(packed++) = sqrt2 * (prow[c] + sym.at<double>(c,r)) / 2;
+        }
+    }
+}
+/***********************************************************/
+double ParticleBuffer::packedDistance(const double *a, const double *b, int L, double bound)
+{
+    double bound2 = bound * bound;
+    double dis2   = 0;
+    int l = 0;
+    while (l < L)
+    {
+        int end = min(l + ABANDON_BLOCK, L);
+#ifdef COV_SSE2
+        __m128d acc = _mm_setzero_pd();
+        for(; l + 2 <= end; l += 2)
+        {
+            __m128d d = _mm_sub_pd(_mm_loadu_pd(a + l), _mm_loadu_pd(b + l));
+            acc = _mm_add_pd(acc, _mm_mul_pd(d, d));
+        }
+        double part[2];
+        _mm_storeu_pd(part, acc);
+        dis2 += part[0] + part[1];
+#endif
+        for(; l < end; l++)
+        {
+            double d = a[l] - b[l];
+            dis2 += d * d;
+        }
+        if (dis2 > bound2)
+        {
+            break;
+        }
+    }
+    return sqrt(dis2);
+}
+/***********************************************************/
+void ParticleBuffer::calcmean(CovImage &cim, int nModes, const double *pos, double *mean)
+{
+    int qx1[4], qy1[4], qx2[4], qy2[4];
+    int nParts = nModes == 9 ? 4 : 2;
+    double m[FEAT_DIM3];
+
+    if(nModes == 9)
+    {
+        utils::getQuadrants(*(pos), *(pos+1), *(pos+2), *(pos+3), qx1, qy1, qx2, qy2);
+    }
+    else
+    {
+        utils::getVerticalHalf(*(pos), *(pos+1), *(pos+2), *(pos+3), qx1, qy1, qx2, qy2);
+    }
+    for (int i = 0; i < nParts; i++) 
+    {
+        cim.meanVector(qx1[i], qy1[i], qx2[i], qy2[i], m);
+        // skip the x,y coordinates, their mean only depends on the position
+        for (int d = 2; d < cim.dim; d++)
+        {
+            *(mean++) = m[d];
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#ifndef __COV_PARTICLE_BUFFER_H__
+#define __COV_PARTICLE_BUFFER_H__
+/*
+* Compact store of the candidate particles of a target. The boxes of the
+* particles are kept in the par_pos matrix of the target; this buffer holds
+* their descriptors in preallocated per-mode slabs so that no object has to
+* be created for a candidate particle. The buffer is reused across frames.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+
+#include "covImage.h"
+#include "SParater.h"
+
+class ParticleBuffer
+{
+public:
+    /* number of particles, modes and feature dimension held in the buffer */
+    int nParticles;
+    int nModes;
+    int dim;
+    /* covariance matrices. cmat[i] is an nParticles x (dim*dim) slab; row k
+    holds the covariance matrix of particle k in mode i */
+    vector<Mat> cmat;
+    /* logm of covariance matrices packed by packlogm(). logmPacked[i] is an
+    nParticles x (dim*(dim+1)/2) slab; row k belongs to particle k */
+    vector<Mat> logmPacked;
+    /* active[i] is 0 when mode i cannot be selected in the current frame.
+    The covariance, logm and distance of such a mode are not computed. */
+    vector<int> active;
+    /* cheap descriptors used by the cascade. Row k holds the mean features
+    of the quadrants (or halves) of particle k, see calcmean() */
+    Mat meanDesc;
+    /* hit counters of the per-frame caches, accumulated over the video */
+    long long compLookups, compHits;
+    long long boxLookups, boxHits;
+
+private:
+    /* scratch matrices reused by every particle */
+    Mat prodM[4];
+    Mat sumM[4];
+    Mat prod, sum;
+    Mat U, W, V;
+    Mat logmFull;
+    Mat dots;
+    /* abandon distances worse than the abandonK-th best distance of the
+    frame so far (0 = never). bestDis[i] keeps the abandonK best distances of
+    mode i as a max-heap. */
+    int abandonK;
+    vector<priority_queue<double> > bestDis;
+    /* per-frame caches (para.memo). Resampled particles often round to the
+    same integer quadrants. compCache row compIndex[key] holds the packed
+    covComponentMatrices output of a quadrant: upper triangle of prodM,
+    sumM and Npixels. boxIndex[key] is the particle whose descriptors were
+    computed for an integer box. */
+    int memo;
+    Mat compCache;
+    int nComp;
+    unordered_map<unsigned long long, int> compIndex;
+    unordered_map<unsigned long long, int> boxIndex;
+
+public:
+    ParticleBuffer() : nParticles(0), nModes(0), dim(0),
+        compLookups(0), compHits(0), boxLookups(0), boxHits(0),
+        abandonK(0), memo(0), nComp(0) {}
+
+    /* make the buffer hold para.nParticles particles with para.nModes modes
+    of dimension dim and reset the state of the frame. This is called at the
+    start of every frame; the memory is only reallocated when a size
+    changes. */
+    void reserve(const Parameter &para, int dim);
+
+    /* activate only the modes that have a non-zero transition probability
+    in the row tranRow of the transition matrix */
+    void setActiveModes(const double *tranRow);
+
+    /* return a dim x dim header on the covariance matrix of particle k in
+    mode i */
+    Mat covmat(int k, int i)
+    {
+        return Mat(dim, dim, CV_64F, cmat[i].ptr<double>(k));
+    }
+
+    /* calculate the covariance matrices of all modes of the box pos
+    [x1,y1,x2,y2] and store them as particle k */
+    void calccovmat(CovImage &cim, Parameter &para, const double *pos, int k);
+
+    /* calculate the logm of the covariance matrices of particle k */
+    void logm(int k);
+
+    /* when a particle with the same integer box as pos has already been
+    evaluated in this frame, copy its descriptors to particle k and return
+    true. Otherwise remember k as the particle of this box and return false. */
+    bool reuseBox(const double *pos, int k);
+
+    /* distance of particle k in mode i to the packed template tarPacked.
+    The computation stops early once the distance exceeds the current
+    abandon bound; the partial distance is returned in that case. */
+    double distance(int k, int i, const double *tarPacked);
+
+    /* distance of particle k in mode i to the nearest of the packed templates
+    in the rows of tmpl, whose squared norms are in tmplNorm2. The distances
+    to all templates come from one matrix-vector product:
+    |a - t|^2 = |a|^2 - 2 t.a + |t|^2 */
+    double nearestDistance(int k, int i, const Mat &tmpl, const Mat &tmplNorm2);
+
+    /* pack the upper triangle of the symmetric dim x dim matrix sym into
+    dim*(dim+1)/2 values. The off-diagonal values are scaled by sqrt(2) so
+    that the Euclidean distance of two packed vectors equals the Frobenius
+    norm of the difference of the matrices. */
+    static void packlogm(const Mat &sym, double *packed);
+
+    /* Euclidean distance of the packed vectors a and b of length L. The sum
+    is abandoned once the distance exceeds bound. */
+    static double packedDistance(const double *a, const double *b, int L, double bound);
+
+    /* key of the integer rectangle (x1,y1,x2,y2) in the caches */
+    static unsigned long long rectKey(int x1, int y1, int x2, int y2)
+    {
+        return ((unsigned long long)(x1 & 0xFFFF) << 48) |
+            ((unsigned long long)(y1 & 0xFFFF) << 32) |
+            ((unsigned long long)(x2 & 0xFFFF) << 16) |
+            (unsigned long long)(y2 & 0xFFFF);
+    }
+
+    /* length of the cheap descriptor: the mean of every feature except the
+    x,y coordinates, in each of the 4 quadrants (9 modes) or 2 halves (3
+    modes) of the box */
+    static int meanLength(int nModes, int dim)
+    {
+        return (nModes == 9 ? 4 : 2) * (dim - 2);
+    }
+
+    /* calculate the cheap descriptor of the box pos [x1,y1,x2,y2] from the
+    IIsum part of the integral image only */
+    static void calcmean(CovImage &cim, int nModes, const double *pos, double *mean);
+};
+
+#endif
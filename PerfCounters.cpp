@@ -0,0 +1,134 @@
+/*
+* Hardware performance counters through Linux perf_event_open.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+
+#include "PerfCounters.h"
+#include "debug.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace std;
+
+static const char *g_eventNames[PERF_EVENTS] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses"
+};
+
+#ifdef __linux__
+/* type and config of every event */
+static const __u32 g_eventTypes[PERF_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+};
+static const __u64 g_eventConfigs[PERF_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+};
+
+/***********************************************************/
+static int OpenEvent(int e, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = g_eventTypes[e];
+    attr.config         = g_eventConfigs[e];
+    attr.disabled       = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                          PERF_FORMAT_TOTAL_TIME_RUNNING;
+    //calling thread on any cpu
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+/***********************************************************/
+PerfCounters::PerfCounters()
+{
+    for (int e = 0; e < PERF_EVENTS; ++e)
+    {
+        m_fd[e]   = -1;
+        m_slot[e] = -1;
+    }
+#ifdef __linux__
+    m_fd[PERF_CYCLES] = OpenEvent(PERF_CYCLES, -1);
+    if (m_fd[PERF_CYCLES] < 0)
+    {
+        ERROR_OUT__<<" perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid"<<endl;
+        return;
+    }
+    int nOpened = 0;
+    m_slot[PERF_CYCLES] = nOpened++;
+    for (int e = PERF_CYCLES + 1; e < PERF_EVENTS; ++e)
+    {
+        m_fd[e] = OpenEvent(e, m_fd[PERF_CYCLES]);
+        if (m_fd[e] < 0)
+        {
+            cerr<<"perf counter "<<g_eventNames[e]<<" is not available"<<endl;
+            continue;
+        }
+        m_slot[e] = nOpened++;
+    }
+    ioctl(m_fd[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fd[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    cerr<<"hardware counters need Linux perf_event_open, only timing is profiled"<<endl;
+#endif
+}
+/***********************************************************/
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    //members first, the leader closes the group
+    for (int e = PERF_EVENTS - 1; e >= 0; --e)
+    {
+        if (m_fd[e] >= 0)
+        {
+            close(m_fd[e]);
+        }
+    }
+#endif
+}
+/***********************************************************/
+const char *PerfCounters::eventName(int e)
+{
+    return g_eventNames[e];
+}
+/***********************************************************/
+void PerfCounters::read(uint64 *sample)
+{
+    memset(sample, 0, PERF_SAMPLE * sizeof(uint64));
+#ifdef __linux__
+    if (available() && ::read(m_fd[PERF_CYCLES], sample, PERF_SAMPLE * sizeof(uint64)) <= 0)
+    {
+        memset(sample, 0, PERF_SAMPLE * sizeof(uint64));
+    }
+#endif
+}
+/***********************************************************/
+void PerfCounters::delta(const uint64 *begin, const uint64 *end, double *counts) const
+{
+    double enabled = (double)(end[1] - begin[1]);
+    double running = (double)(end[2] - begin[2]);
+    //a failed read leaves the sample at zero events
+    double scale   = running > 0 && begin[0] && end[0] ? enabled / running : 0;
+    for (int e = 0; e < PERF_EVENTS; ++e)
+    {
+        counts[e] = 0;
+        if (m_slot[e] >= 0)
+        {
+            counts[e] = (double)(end[3 + m_slot[e]] - begin[3 + m_slot[e]]) * scale;
+        }
+    }
+}
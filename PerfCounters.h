@@ -0,0 +1,58 @@
+#ifndef __COV_PERF_COUNTERS_H__
+#define __COV_PERF_COUNTERS_H__
+/*
+* Hardware performance counters of the calling thread, read through Linux
+* perf_event_open as one group so that all events cover the same interval.
+* Kernel and hypervisor time are excluded, which lets the counters open with
+* the default perf_event_paranoid setting. Events the CPU or the virtual
+* machine does not provide are left out; on other systems no counter is
+* available and the profiler keeps timing only, which is the case of the
+* Windows project; CMakeLists.txt builds the program with them on Linux.
+*/
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/* counted events */
+enum PerfEvent
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_EVENTS
+};
+
+/* one group read: number of events, time enabled, time running, counts */
+#define PERF_SAMPLE (PERF_EVENTS + 3)
+
+class PerfCounters
+{
+public:
+    /* open and start the counters of the calling thread */
+    PerfCounters();
+    ~PerfCounters();
+
+    /* true when at least the cycles could be counted */
+    inline bool available() const { return m_fd[PERF_CYCLES] >= 0; }
+    /* true when event e is counted */
+    inline bool has(int e) const { return m_fd[e] >= 0; }
+    /* name of an event as written in the reports */
+    static const char *eventName(int e);
+
+    /* read the current values of the group */
+    void read(uint64 *sample);
+    /* counts of every event between two samples, scaled by the share of
+    the interval the group was scheduled when the PMU is multiplexed */
+    void delta(const uint64 *begin, const uint64 *end, double *counts) const;
+
+private:
+    int m_fd[PERF_EVENTS];
+    /* position of every event in a group read */
+    int m_slot[PERF_EVENTS];
+
+    PerfCounters(const PerfCounters &);
+    PerfCounters &operator=(const PerfCounters &);
+};
+
+#endif
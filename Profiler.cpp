@@ -0,0 +1,427 @@
+/*
+* Stage profiler of the tracking loop.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+
+#include "Profiler.h"
+#include "debug.h"
+
+#ifdef _MSC_VER
+#define PROF_TLS __declspec(thread)
+#else
+#define PROF_TLS __thread
+#endif
+
+static PROF_TLS Profiler *g_current = NULL;
+/* JSON objects of the finished videos */
+static vector<string> g_summaries;
+
+static const char *g_stageNames[PROF_STAGES] = {
+    "decode", "lab", "features", "integral", "particles", "covariance", "logm",
+    "distance", "mode", "update", "resample", "display", "io"
+};
+static const int g_countedStages[PROF_COUNTED] = {
+    PROF_INTEGRAL, PROF_COVARIANCE, PROF_LOGM
+};
+/* bytes moved by one last-level cache miss */
+#define PROF_LINE_BYTES 64
+
+/***********************************************************/
+Profiler::Profiler(const string &video)
+    : m_video(video), m_frame(0), m_perf(NULL), m_pixels(0),
+      m_allocs(false), m_integral(0)
+{
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        m_acc[s]  = 0;
+        m_slot[s] = -1;
+    }
+}
+/***********************************************************/
+Profiler::~Profiler()
+{
+    delete m_perf;
+}
+/***********************************************************/
+bool Profiler::enableCounters()
+{
+    if (!m_perf)
+    {
+        m_perf = new PerfCounters();
+        if (!m_perf->available())
+        {
+            delete m_perf;
+            m_perf = NULL;
+            return false;
+        }
+        for (int c = 0; c < PROF_COUNTED; ++c)
+        {
+            m_slot[g_countedStages[c]] = c;
+        }
+    }
+    return true;
+}
+/***********************************************************/
+bool Profiler::enableAllocs()
+{
+    if (!alloc::enabled())
+    {
+        cerr<<"allocations are only counted in a build with COV_COUNT_ALLOCS"<<endl;
+        return false;
+    }
+    m_allocs = true;
+    if (!alloc::matDataCounted())
+    {
+        cerr<<"cv::Mat data cannot be hooked here, only operator new is counted"<<endl;
+    }
+    return true;
+}
+/***********************************************************/
+void Profiler::addCounters(int slot, const uint64 *begin)
+{
+    uint64 end[PERF_SAMPLE];
+    double counts[PERF_EVENTS];
+    m_perf->read(end);
+    m_perf->delta(begin, end, counts);
+    for (int e = 0; e < PERF_EVENTS; ++e)
+    {
+        m_counts[slot][e] += counts[e];
+    }
+}
+/***********************************************************/
+void Profiler::attach(Profiler *p)
+{
+    g_current = p;
+}
+/***********************************************************/
+Profiler *Profiler::current()
+{
+    return g_current;
+}
+/***********************************************************/
+const char *Profiler::stageName(int stage)
+{
+    return g_stageNames[stage];
+}
+/***********************************************************/
+void Profiler::beginFrame(int frameNum)
+{
+    m_frame    = frameNum;
+    m_pixels   = 0;
+    m_integral = 0;
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        m_acc[s]      = 0;
+        m_allocAcc[s] = 0;
+        m_byteAcc[s]  = 0;
+    }
+    for (int c = 0; c < PROF_COUNTED; ++c)
+    {
+        for (int e = 0; e < PERF_EVENTS; ++e)
+        {
+            m_counts[c][e] = 0;
+        }
+    }
+    m_frameStart = alloc::threadCounts();
+}
+/***********************************************************/
+void Profiler::endFrame()
+{
+    //totals first, the records below allocate
+    alloc::Counts a = alloc::threadCounts();
+    double ms = 1.E3 / getTickFrequency();
+    m_frames.push_back(m_frame);
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        m_records[s].push_back((float)(m_acc[s] * ms));
+    }
+    if (m_perf)
+    {
+        m_framePixels.push_back(m_pixels);
+        for (int c = 0; c < PROF_COUNTED; ++c)
+        {
+            for (int e = 0; e < PERF_EVENTS; ++e)
+            {
+                m_countRecords[c][e].push_back(m_counts[c][e]);
+            }
+        }
+    }
+    if (m_allocs)
+    {
+        m_frameAllocs.push_back((int)(a.allocs - m_frameStart.allocs));
+        m_frameBytes.push_back((double)(a.bytes - m_frameStart.bytes));
+        m_frameLive.push_back((double)a.live);
+        m_frameIntegral.push_back((double)m_integral);
+        for (int s = 0; s < PROF_STAGES; ++s)
+        {
+            m_allocRecords[s].push_back((int)m_allocAcc[s]);
+            m_byteRecords[s].push_back((double)m_byteAcc[s]);
+        }
+    }
+}
+/***********************************************************/
+void Profiler::merge(const Profiler &worker)
+{
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        m_acc[s]      += worker.m_acc[s];
+        m_allocAcc[s] += worker.m_allocAcc[s];
+        m_byteAcc[s]  += worker.m_byteAcc[s];
+    }
+}
+/***********************************************************/
+ProfWorker::ProfWorker(Profiler *parent)
+    : m_parent(parent), m_local(NULL), m_previous(NULL)
+{
+    //the thread that opened the region keeps recording into parent
+    if (parent && Profiler::current() != parent)
+    {
+        m_previous = Profiler::current();
+        m_local    = new Profiler("");
+        m_local->m_allocs = parent->m_allocs;
+        m_local->beginFrame(0);
+        Profiler::attach(m_local);
+    }
+}
+/***********************************************************/
+ProfWorker::~ProfWorker()
+{
+    if (m_local)
+    {
+        Profiler::attach(m_previous);
+        #pragma omp critical(prof_worker)
+        m_parent->merge(*m_local);
+        delete m_local;
+    }
+}
+/***********************************************************/
+void Profiler::writeFrames(const string &path)
+{
+    ofstream out(path.c_str(), ios::trunc);
+    out<<"frame";
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        out<<","<<g_stageNames[s]<<"_ms";
+    }
+    if (m_perf)
+    {
+        out<<",pixels";
+        for (int c = 0; c < PROF_COUNTED; ++c)
+        {
+            for (int e = 0; e < PERF_EVENTS; ++e)
+            {
+                out<<","<<g_stageNames[g_countedStages[c]]<<"_"<<PerfCounters::eventName(e);
+            }
+        }
+    }
+    if (m_allocs)
+    {
+        out<<",frame_allocs,frame_alloc_bytes,heap_live_bytes,integral_bytes";
+        for (int s = 0; s < PROF_STAGES; ++s)
+        {
+            out<<","<<g_stageNames[s]<<"_allocs,"<<g_stageNames[s]<<"_alloc_bytes";
+        }
+    }
+    out<<'\n';
+    for (int n = 0; n < m_frames.size(); ++n)
+    {
+        out<<m_frames[n];
+        for (int s = 0; s < PROF_STAGES; ++s)
+        {
+            out<<","<<m_records[s][n];
+        }
+        if (m_perf)
+        {
+            out<<","<<m_framePixels[n];
+            for (int c = 0; c < PROF_COUNTED; ++c)
+            {
+                for (int e = 0; e < PERF_EVENTS; ++e)
+                {
+                    //events the CPU does not count are left empty
+                    out<<",";
+                    if (m_perf->has(e))
+                    {
+                        out<<(int64)m_countRecords[c][e][n];
+                    }
+                }
+            }
+        }
+        if (m_allocs)
+        {
+            out<<","<<m_frameAllocs[n]<<","<<(int64)m_frameBytes[n]
+               <<","<<(int64)m_frameLive[n]<<","<<(int64)m_frameIntegral[n];
+            for (int s = 0; s < PROF_STAGES; ++s)
+            {
+                out<<","<<m_allocRecords[s][n]<<","<<(int64)m_byteRecords[s][n];
+            }
+        }
+        out<<'\n';
+    }
+}
+/***********************************************************/
+/* nearest-rank percentile of sorted values */
+static double Percentile(const vector<float> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    int rank = (int)ceil(p / 100 * sorted.size()) - 1;
+    return sorted[min(max(rank, 0), (int)sorted.size() - 1)];
+}
+/***********************************************************/
+void Profiler::finish()
+{
+    stringstream json;
+    json<<"    {\"video\": \""<<m_video<<"\", \"frames\": "<<m_frames.size()
+        <<", \"stages\": {";
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        vector<float> sorted(m_records[s]);
+        sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (int n = 0; n < sorted.size(); ++n)
+        {
+            total += sorted[n];
+        }
+        json<<(s ? ",\n" : "\n")<<"      \""<<g_stageNames[s]<<"\": {"
+            <<"\"total_ms\": "<<total
+            <<", \"mean_ms\": "<<(sorted.empty() ? 0 : total / sorted.size())
+            <<", \"p50_ms\": "<<Percentile(sorted, 50)
+            <<", \"p95_ms\": "<<Percentile(sorted, 95)
+            <<", \"p99_ms\": "<<Percentile(sorted, 99)<<"}";
+    }
+    json<<"\n    }";
+    if (m_perf)
+    {
+        writeCounters(json);
+    }
+    if (m_allocs)
+    {
+        writeAllocs(json);
+    }
+    json<<"}";
+    #pragma omp critical (profiler_summary)
+    g_summaries.push_back(json.str());
+}
+/***********************************************************/
+/* JSON member of the counter totals, printed as well */
+void Profiler::writeCounters(ostream &json)
+{
+    double pixels = 0;
+    for (int n = 0; n < m_framePixels.size(); ++n)
+    {
+        pixels += (double)m_framePixels[n];
+    }
+    double nFrames = max((double)m_frames.size(), 1.0);
+    json<<",\n    \"pixels_per_frame\": "<<pixels / nFrames<<", \"counters\": {";
+    for (int c = 0; c < PROF_COUNTED; ++c)
+    {
+        double total[PERF_EVENTS];
+        for (int e = 0; e < PERF_EVENTS; ++e)
+        {
+            total[e] = 0;
+            for (int n = 0; n < m_countRecords[c][e].size(); ++n)
+            {
+                total[e] += m_countRecords[c][e][n];
+            }
+        }
+        const char *name = g_stageNames[g_countedStages[c]];
+        json<<(c ? ",\n" : "\n")<<"      \""<<name<<"\": {";
+        for (int e = 0; e < PERF_EVENTS; ++e)
+        {
+            json<<"\""<<PerfCounters::eventName(e)<<"_per_frame\": ";
+            if (m_perf->has(e))
+            {
+                json<<total[e] / nFrames<<", ";
+            }
+            else
+            {
+                json<<"null, ";
+            }
+        }
+        double ipc = total[PERF_CYCLES] > 0 ? total[PERF_INSTRUCTIONS] / total[PERF_CYCLES] : 0;
+        double bpp = pixels > 0 ? total[PERF_LLC_MISSES] * PROF_LINE_BYTES / pixels : 0;
+        double cpp = pixels > 0 ? total[PERF_CYCLES] / pixels : 0;
+        json<<"\"ipc\": "<<ipc<<", \"cycles_per_pixel\": "<<cpp<<", \"bytes_per_pixel\": ";
+        if (m_perf->has(PERF_LLC_MISSES))
+        {
+            json<<bpp<<"}";
+        }
+        else
+        {
+            json<<"null}";
+        }
+        cerr<<m_video<<" "<<name<<": IPC "<<ipc<<", "<<cpp<<" cycles/pixel, "
+            <<bpp<<" bytes/pixel from LLC misses"<<endl;
+    }
+    json<<"\n    }";
+}
+/***********************************************************/
+/* mean of values */
+template <class T>
+static double Mean(const vector<T> &values)
+{
+    double total = 0;
+    for (int n = 0; n < values.size(); ++n)
+    {
+        total += values[n];
+    }
+    return values.empty() ? 0 : total / values.size();
+}
+/***********************************************************/
+/* JSON member of the allocation counts. The median of the frame counts is
+the steady state: the first frames also allocate the buffers reused later.
+*/
+void Profiler::writeAllocs(ostream &json)
+{
+    vector<float> sorted(m_frameAllocs.begin(), m_frameAllocs.end());
+    sort(sorted.begin(), sorted.end());
+    double steady = Percentile(sorted, 50);
+    double integral = m_frameIntegral.empty() ? 0 :
+        *max_element(m_frameIntegral.begin(), m_frameIntegral.end());
+    alloc::Counts a = alloc::counts();
+    json<<",\n    \"allocs\": {\"mat_data_counted\": "<<(alloc::matDataCounted() ? "true" : "false")
+        <<", \"allocs_per_frame\": "<<Mean(m_frameAllocs)
+        <<", \"steady_allocs_per_frame\": "<<steady
+        <<", \"max_allocs_per_frame\": "<<(sorted.empty() ? 0 : sorted.back())
+        <<", \"bytes_per_frame\": "<<Mean(m_frameBytes)
+        <<", \"integral_peak_bytes\": "<<integral
+        <<", \"heap_peak_bytes\": "<<a.peak
+        <<", \"stages\": {";
+    for (int s = 0; s < PROF_STAGES; ++s)
+    {
+        json<<(s ? ",\n" : "\n")<<"      \""<<g_stageNames[s]<<"\": {"
+            <<"\"allocs_per_frame\": "<<Mean(m_allocRecords[s])
+            <<", \"bytes_per_frame\": "<<Mean(m_byteRecords[s])<<"}";
+    }
+    json<<"\n    }}";
+    cerr<<m_video<<": "<<steady<<" allocations per frame in steady state, integral buffers "
+        <<integral / (1<<20)<<" MB, heap peak "<<a.peak / (double)(1<<20)<<" MB"<<endl;
+}
+/***********************************************************/
+void Profiler::writeSummary(const string &path)
+{
+    if (g_summaries.empty())
+    {
+        return;
+    }
+    ofstream out(path.c_str(), ios::trunc);
+    if (!out.is_open())
+    {
+        ERROR_OUT__<<" cannot open "<<path<<endl;
+        return;
+    }
+    out<<"{\n  \"videos\": [\n";
+    for (int n = 0; n < g_summaries.size(); ++n)
+    {
+        out<<g_summaries[n]<<(n + 1 < g_summaries.size() ? ",\n" : "\n");
+    }
+    out<<"  ]\n}\n";
+}
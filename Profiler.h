@@ -0,0 +1,222 @@
+#ifndef __COV_PROFILER_H__
+#define __COV_PROFILER_H__
+/*
+* Stage profiler of the tracking loop. A scope opened with PROF_SCOPE(stage)
+* adds its duration to the profiler attached to the current thread, if any.
+* The times of a frame are kept as one record per frame; at the end of a
+* video the p50/p95/p99 of every stage are computed and kept for the JSON
+* summary written at exit. Scopes nest: the particle evaluation includes
+* covariance, logm and distance. The cost of a scope is two tick counts and
+* a thread-local read; defining COV_NO_PROFILER removes the scopes entirely.
+* The threads of a parallel region open PROF_WORKER(parent) first: each
+* records into a profiler of its own, added to parent when the thread leaves
+* the region, so that the stages sum the time of all threads and can exceed
+* the wall time of the scope around the region.
+*
+* With enableCounters() the integral, covariance and logm scopes also read
+* the hardware counters of the thread (see PerfCounters.h). Every frame then
+* records their cycles, instructions, LLC and dTLB misses, and the summary
+* reports the IPC and the bytes per pixel: LLC misses times the cache line
+* divided by the pixels integrated in the frame. Reading the counters is a
+* system call at each end of a scope. The counters are those of the thread
+* that enabled them; PROF_WORKER threads add their times, not their counts.
+*
+* With enableAllocs() every scope also counts the heap allocations and bytes
+* of the thread (see AllocCounter.h for what is counted), and every frame
+* records its total allocations, the heap in use at its end and the size of
+* the integral buffers. The summary reports the allocations per frame, their
+* median over the frames as the steady state, and the peaks.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+#include "AllocCounter.h"
+
+using namespace std;
+using namespace cv;
+
+/* profiled stages */
+enum ProfStage
+{
+    PROF_DECODE = 0,
+    PROF_LAB,
+    PROF_FEATURES,
+    PROF_INTEGRAL,
+    PROF_PARTICLES,
+    PROF_COVARIANCE,
+    PROF_LOGM,
+    PROF_DISTANCE,
+    PROF_MODE,
+    PROF_UPDATE,
+    PROF_RESAMPLE,
+    PROF_DISPLAY,
+    PROF_IO,
+    PROF_STAGES
+};
+
+/* stages read with the hardware counters */
+#define PROF_COUNTED 3
+
+class Profiler
+{
+public:
+    Profiler(const string &video);
+    ~Profiler();
+
+    /* read the hardware counters of the calling thread in the integral,
+    covariance and logm stages; returns false when they are not available */
+    bool enableCounters();
+    /* count the heap allocations of every stage and frame; returns false
+    when the program was built without COV_COUNT_ALLOCS */
+    bool enableAllocs();
+
+    /* attach p to the calling thread, NULL detaches */
+    static void attach(Profiler *p);
+    /* profiler of the calling thread, NULL when none is attached */
+    static Profiler *current();
+    /* name of a stage as written in the summary */
+    static const char *stageName(int stage);
+
+    /* start and close the record of one frame */
+    void beginFrame(int frameNum);
+    void endFrame();
+    /* add ticks to a stage of the current frame */
+    inline void add(int stage, int64 ticks) { m_acc[stage] += ticks; }
+    /* position of a stage among the counted ones, -1 when it is not read */
+    inline int counterSlot(int stage) const { return m_slot[stage]; }
+    /* read the counters, and add the counts since begin to a counted stage */
+    inline void readCounters(uint64 *sample) { m_perf->read(sample); }
+    void addCounters(int slot, const uint64 *begin);
+    /* add pixels integrated in the current frame */
+    inline void addPixels(int64 pixels) { m_pixels += pixels; }
+    /* true when the allocations are counted */
+    inline bool countsAllocs() const { return m_allocs; }
+    /* add allocations to a stage of the current frame */
+    inline void addAllocs(int stage, long long allocs, long long bytes)
+    {
+        m_allocAcc[stage] += allocs;
+        m_byteAcc[stage]  += bytes;
+    }
+    /* note the bytes of the integral buffers of the current frame */
+    inline void addIntegralBytes(int64 bytes) { m_integral = max(m_integral, bytes); }
+
+    /* add the stage times and allocations of the current frame of a worker */
+    void merge(const Profiler &worker);
+
+    /* write the per-frame records as CSV, in milliseconds */
+    void writeFrames(const string &path);
+    /* compute the percentiles of the video and keep them for the summary */
+    void finish();
+    /* write the summary of all finished videos as JSON */
+    static void writeSummary(const string &path);
+
+private:
+    void writeCounters(ostream &json);
+    void writeAllocs(ostream &json);
+
+    string m_video;
+    int m_frame;
+    int64 m_acc[PROF_STAGES];
+    /* frame numbers and per-frame milliseconds of every stage */
+    vector<int> m_frames;
+    vector<float> m_records[PROF_STAGES];
+    /* hardware counters, NULL when they are not read */
+    PerfCounters *m_perf;
+    int m_slot[PROF_STAGES];
+    double m_counts[PROF_COUNTED][PERF_EVENTS];
+    int64 m_pixels;
+    /* per-frame pixels and counts of the counted stages */
+    vector<int64> m_framePixels;
+    vector<double> m_countRecords[PROF_COUNTED][PERF_EVENTS];
+    /* allocation counts, per stage in the current frame and per frame */
+    bool m_allocs;
+    long long m_allocAcc[PROF_STAGES];
+    long long m_byteAcc[PROF_STAGES];
+    alloc::Counts m_frameStart;
+    int64 m_integral;
+    vector<int> m_allocRecords[PROF_STAGES];
+    vector<double> m_byteRecords[PROF_STAGES];
+    vector<int> m_frameAllocs;
+    vector<double> m_frameBytes;
+    vector<double> m_frameLive;
+    vector<double> m_frameIntegral;
+
+    Profiler(const Profiler &);
+    Profiler &operator=(const Profiler &);
+
+    friend class ProfWorker;
+};
+
+/* profiles a thread of a parallel region, see PROF_WORKER */
+class ProfWorker
+{
+public:
+    ProfWorker(Profiler *parent);
+    ~ProfWorker();
+private:
+    Profiler *m_parent;
+    Profiler *m_local;
+    Profiler *m_previous;
+};
+
+/* times the enclosing scope */
+class ProfScope
+{
+public:
+    inline ProfScope(int stage) : m_stage(stage), m_prof(Profiler::current()), m_slot(-1)
+    {
+        if (m_prof)
+        {
+            m_slot = m_prof->counterSlot(stage);
+            if (m_slot >= 0)
+            {
+                m_prof->readCounters(m_sample);
+            }
+            if (m_prof->countsAllocs())
+            {
+                m_allocs0 = alloc::threadCounts();
+            }
+            m_start = getTickCount();
+        }
+    }
+    inline ~ProfScope()
+    {
+        if (m_prof)
+        {
+            m_prof->add(m_stage, getTickCount() - m_start);
+            if (m_slot >= 0)
+            {
+                m_prof->addCounters(m_slot, m_sample);
+            }
+            if (m_prof->countsAllocs())
+            {
+                alloc::Counts a = alloc::threadCounts();
+                m_prof->addAllocs(m_stage, a.allocs - m_allocs0.allocs, a.bytes - m_allocs0.bytes);
+            }
+        }
+    }
+private:
+    int m_stage;
+    Profiler *m_prof;
+    int m_slot;
+    int64 m_start;
+    uint64 m_sample[PERF_SAMPLE];
+    alloc::Counts m_allocs0;
+};
+
+#ifndef COV_NO_PROFILER
+#define PROF_SCOPE(stage) ProfScope prof_scope__(stage)
+#define PROF_WORKER(parent) ProfWorker prof_worker__(parent)
+#else
+#define PROF_SCOPE(stage)
+#define PROF_WORKER(parent)
+#endif
+
+#endif
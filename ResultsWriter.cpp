@@ -0,0 +1,117 @@
+/*
+* Buffered writer of the per-frame tracking results.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <iomanip>
+
+#include "ResultsWriter.h"
+#include "debug.h"
+#include "Profiler.h"
+
+/* records kept in memory before they are written */
+#define RESULTS_BLOCK 1024
+
+/***********************************************************/
+ResultsWriter::ResultsWriter(const string &path, const string &file, int dataset, int format)
+    : m_format(format)
+{
+    m_buffer.reserve(RESULTS_BLOCK);
+    if (m_format == 1)
+    {
+        m_out.open((path + ".csv").c_str(), ios::trunc);
+        m_out<<"frame,mode,x1,y1,x2,y2,best_dis,particles,evaluated,"
+             <<"t_load_ms,t_search_ms,t_update_ms,t_resample_ms"<<'\n';
+    }
+    else if (m_format == 2)
+    {
+        m_out.open((path + ".bin").c_str(), ios::trunc | ios::binary);
+        int32_t header[4];
+        memcpy(header, "CVTR", 4);
+        header[1] = VERSION;
+        header[2] = RECORD_BYTES;
+        header[3] = dataset;
+        m_out.write((const char*)header, sizeof(header));
+    }
+    else
+    {
+        m_out.open((path + ".txt").c_str(), ios::trunc);
+        m_out<<file<<" "<<dataset<<'\n';
+    }
+    if (!m_out.is_open())
+    {
+        ERROR_OUT__<<" cannot open results file "<<path<<endl;
+    }
+    m_out<<setprecision(16);
+}
+/***********************************************************/
+ResultsWriter::~ResultsWriter()
+{
+    flush();
+    m_out.close();
+}
+/***********************************************************/
+void ResultsWriter::append(const FrameRecord &rec)
+{
+    m_buffer.push_back(rec);
+    if (m_buffer.size() >= RESULTS_BLOCK)
+    {
+        flush();
+    }
+}
+/***********************************************************/
+void ResultsWriter::flush()
+{
+    PROF_SCOPE(PROF_IO);
+    for (int n = 0; n < m_buffer.size(); ++n)
+    {
+        if (m_format == 1)
+        {
+            writeCSV(m_buffer[n]);
+        }
+        else if (m_format == 2)
+        {
+            writeBinary(m_buffer[n]);
+        }
+        else
+        {
+            writeText(m_buffer[n]);
+        }
+    }
+    m_buffer.clear();
+    m_out.flush();
+}
+/***********************************************************/
+void ResultsWriter::writeText(const FrameRecord &rec)
+{
+    m_out<<rec.frame<<" "<<rec.mode<<" ["
+         <<rec.box[0]<<", "<<rec.box[1]<<", "<<rec.box[2]<<", "<<rec.box[3]<<"]"<<'\n';
+}
+/***********************************************************/
+void ResultsWriter::writeCSV(const FrameRecord &rec)
+{
+    m_out<<rec.frame<<','<<rec.mode<<','
+         <<rec.box[0]<<','<<rec.box[1]<<','<<rec.box[2]<<','<<rec.box[3]<<','
+         <<rec.bestDis<<','<<rec.nParticles<<','<<rec.nEvaluated<<','
+         <<rec.tLoad<<','<<rec.tSearch<<','<<rec.tUpdate<<','<<rec.tResample<<'\n';
+}
+/***********************************************************/
+void ResultsWriter::writeBinary(const FrameRecord &rec)
+{
+    //packed field by field, the struct may contain padding
+    char buf[RECORD_BYTES];
+    char *p = buf;
+    int32_t ints[2] = {rec.frame, rec.mode};
+    memcpy(p, ints, 8);                p += 8;
+    memcpy(p, rec.box, 32);            p += 32;
+    memcpy(p, &rec.bestDis, 8);        p += 8;
+    ints[0] = rec.nParticles;
+    ints[1] = rec.nEvaluated;
+    memcpy(p, ints, 8);                p += 8;
+    double times[4] = {rec.tLoad, rec.tSearch, rec.tUpdate, rec.tResample};
+    memcpy(p, times, 32);
+    m_out.write(buf, RECORD_BYTES);
+}
@@ -0,0 +1,76 @@
+#ifndef __COV_RESULTS_WRITER_H__
+#define __COV_RESULTS_WRITER_H__
+/*
+* Buffered writer of the per-frame tracking results. Records are kept in
+* memory and formatted in blocks, so nothing is formatted or flushed while a
+* frame is tracked. Three formats are written:
+*
+* 0 text  <file>.txt  the original format read by the Matlab/Python scripts
+*                     first line "<file> <dataset>", then
+*                     "frame mode [x1, y1, x2, y2]"
+* 1 CSV   <file>.csv  header line, then one line per frame with the columns
+*                     frame,mode,x1,y1,x2,y2,best_dis,particles,evaluated,
+*                     t_load_ms,t_search_ms,t_update_ms,t_resample_ms
+* 2 binary <file>.bin header of 16 bytes: "CVTR", version, record size and
+*                     dataset as little-endian int32, then one record of
+*                     RECORD_BYTES per frame with the CSV columns in order:
+*                     int32 frame, int32 mode, 5 x float64 (box, best_dis),
+*                     2 x int32 (particles, evaluated), 4 x float64 timings
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* results of one target in one frame. Timings are in milliseconds. */
+struct FrameRecord
+{
+    int frame;
+    int mode;
+    double box[4];
+    double bestDis;
+    int nParticles;
+    int nEvaluated;
+    double tLoad;
+    double tSearch;
+    double tUpdate;
+    double tResample;
+};
+
+class ResultsWriter
+{
+public:
+    /* version of the CSV and binary schema */
+    static const int VERSION = 1;
+    /* size of one binary record */
+    static const int RECORD_BYTES = 4*2 + 8*5 + 4*2 + 8*4;
+
+    /* open path + extension of the format for writing */
+    ResultsWriter(const string &path, const string &file, int dataset, int format);
+    /* write the records still buffered */
+    ~ResultsWriter();
+
+    /* keep one record, written when the buffer is full or on close */
+    void append(const FrameRecord &rec);
+    /* write the buffered records */
+    void flush();
+
+private:
+    ResultsWriter(const ResultsWriter&);
+    ResultsWriter& operator=(const ResultsWriter&);
+
+    void writeText(const FrameRecord &rec);
+    void writeCSV(const FrameRecord &rec);
+    void writeBinary(const FrameRecord &rec);
+
+    int m_format;
+    ofstream m_out;
+    vector<FrameRecord> m_buffer;
+};
+
+#endif
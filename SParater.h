@@ -14,6 +14,7 @@ struct Parameter{
     int nParticles;
     int nModes;
     int dataset;
+    int nTargets;
     /***************************************/
     double std_x;
     double std_y;
@@ -33,6 +34,44 @@ struct Parameter{
     int currentMode;
     /***************************************/
     int updateFreq;
+    int seed;           // seed of the particle RNG, 0 = seed from the clock
+    /***************************************/
+    int cascade;        // reject particles on cheap descriptors first
+    double cascadeKeep; // fraction of particles kept for full evaluation
+    int abandonK;       // abandon distances worse than the k-th best (0 = off)
+    int memo;           // 1 = cache quadrant components, 2 = also whole boxes
+    int dense;          // 1 = exhaustive sliding-window search instead of particles
+    int denseStride;    // step in pixels between the windows
+    double budgetMs;    // time budget of the particle evaluation per frame (0 = off)
+    int batchWorkers;   // >0: track the videos concurrently on this many threads
+    int display;        // 0 = headless, no HighGUI window
+    int render;         // 1 = render results to images, 2 = to a video
+    string renderDir;   // output directory of the rendering
+    int renderQueue;    // frames waiting for the renderer before new ones are dropped
+    string sweepFile;   // parameter sets of a sweep, empty = no sweep
+    int frameStore;     // 1 = frames from a pre-decoded store, 2 = in Lab
+    int roiDecode;      // 1 = decode only the search areas of JPEG frames
+    int greyDetect;     // 1 = track in greyscale when the first frame has no colour
+    double greyChroma;  // chroma in grey levels below which a frame has no colour
+    int greyscale;      // 1 = the frames are read as greyscale (set per video)
+    int resultsFormat;  // 0 = text, 1 = CSV, 2 = binary (see ResultsWriter.h)
+    int profile;        // 1 = time the stages of every frame (see Profiler.h)
+    int perfCounters;   // 1 = read the hardware counters in the profiler
+    int profileAllocs;  // 1 = count the heap allocations in the profiler
+    /***************************************/
+    int adaptive;       // choose nParticles every frame by KLD-sampling
+    int minParticles;
+    int maxParticles;
+    double kldEpsilon;  // bound of the KL divergence
+    double kldZ;        // upper normal quantile of the confidence
+    double kldBin;      // bin size in pixels of [x,y,w,h]
+    /***************************************/
+    /* counters of the last particle search */
+    int nOutside;       // particles outside the search area
+    int nPruned;        // particles rejected by the cascade
+    int nEvaluated;     // particles evaluated with full descriptors
+    int nLate;          // particles left unevaluated at the deadline
+    double bestDis;     // distance of the selected particle to the target
 
 };
 #endif
\ No newline at end of file
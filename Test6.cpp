@@ -4,54 +4,662 @@ Chenghuan Liu , Du Huynh, Jan 2017.
 
 #include "Test6.h"
 
-int main(int argc, char** argv)
+/* milliseconds since t, t is moved to now */
+static double LapMs(int64 &t)
 {
-    vector<string> video_list;
-    utils::LoadVideoList(video_list);
+    int64 now = getTickCount();
+    double ms = 1.E3 * (now - t) / getTickFrequency();
+    t = now;
+    return ms;
+}
 
-    Parameter para;
-    for(int video_count = 0; video_count < video_list.size(); ++video_count)
+/* results of the search of one target in frame i */
+static FrameRecord SearchRecord(int i, Cparticle &tarpar, Parameter &para)
+{
+    FrameRecord rec;
+    rec.frame      = i+1;
+    rec.mode       = para.currentMode+1;
+    double *ppos   = tarpar.m_pos.ptr<double>(0);
+    for(int j = 0; j < 4; ++j)
     {
-        //load parameters from config.ini
-        para.file = video_list[video_count];
+        rec.box[j] = ppos[j];
+    }
+    rec.bestDis    = para.bestDis;
+    rec.nParticles = para.nParticles;
+    rec.nEvaluated = para.nEvaluated;
+    rec.tLoad = rec.tSearch = rec.tUpdate = rec.tResample = 0;
+    return rec;
+}
+
+/* attach the profiler of a video to the calling thread, as configured */
+static void StartProfile(Profiler &prof, Parameter &para)
+{
+    if(para.profile && para.perfCounters)
+    {
+        prof.enableCounters();
+    }
+    if(para.profile && para.profileAllocs)
+    {
+        prof.enableAllocs();
+    }
+    Profiler::attach(para.profile ? &prof : NULL);
+}
+
+/* detach the profiler of a video and keep its records and summary */
+static void FinishProfile(Profiler &prof, Parameter &para)
+{
+    Profiler::attach(NULL);
+    if(para.profile)
+    {
+        prof.writeFrames(".//results//" + para.file + "_profile.csv");
+        prof.finish();
+    }
+}
+
+/* path of the frame store of a video */
+static string FrameStorePath(Parameter &para)
+{
+    return para.route + para.file + (para.frameStore == 2 ? "_lab.cvfs" : ".cvfs");
+}
+
+/* the frame store of a video when para.frameStore is set, packed from the
+image files when it is missing, invalid, too short or older than the image
+files (FrameStore::matches); NULL when the frames
+are decoded from the files. A store that exists but cannot be opened is
+not packed again. Lab frames cannot be shown, display and rendering are
+turned off with them.
+*/
+static FrameStore *OpenFrameStore(Parameter &para, vector<string> &filename)
+{
+    if(!para.frameStore)
+    {
+        return NULL;
+    }
+    string path = FrameStorePath(para);
+    FrameStore *store = new FrameStore(path);
+    FrameStore::Status status = store->status();
+    bool stale = status == FrameStore::STORE_OK &&
+                 (store->frames() < para.endFrame || !store->matches(filename));
+    if(stale)
+    {
+        cerr<<"The frame store "<<path<<" does not match the image files"<<endl;
+    }
+    if(status == FrameStore::STORE_MISSING || status == FrameStore::STORE_INVALID || stale)
+    {
+        delete store;
+        store = NULL;
+        if(FrameStore::pack(filename,path,para.frameStore == 2))
+        {
+            store = new FrameStore(path);
+        }
+    }
+    if(store && !store->isOpen())
+    {
+        delete store;
+        store = NULL;
+    }
+    if(store && store->isLab() && (para.display || para.render))
+    {
+        cerr<<"Lab frames cannot be shown, display and rendering are off"<<endl;
+        para.display = 0;
+        para.render  = 0;
+    }
+    return store;
+}
+
+/* set para.greyscale when para.greyDetect is on and the first frame, a
+colour image, has no colour; the frames are then read as greyscale.
+*/
+static void DetectGreyscale(Parameter &para, const Mat &first)
+{
+    para.greyscale = para.greyDetect && utils::IsGreyscale(first,para.greyChroma);
+    if(para.greyscale)
+    {
+        cerr<<"No colour in "<<para.file<<", tracking in greyscale"<<endl;
+    }
+}
+
+/* frame i from the store, or decoded from its file when there is none */
+template <class T>
+static CovImage LoadFrame(FrameStore *store, vector<string> &filename, int i, T &tarpos, Parameter &para)
+{
+    if(store)
+    {
+        return CovImage(store->frame(i),tarpos,para.greyscale != 0);
+    }
+    return CovImage(filename[i],tarpos,para.greyscale != 0,para.roiDecode != 0);
+}
+
+/* track several targets in the same video. Every frame is decoded once and a
+single integral image is built over the merged search areas of all targets.
+Frames are shown, unless para.display is off, and logged only when
+interactive is set.
+*/
+static void TrackMultiTarget(Parameter &para, bool interactive)
+{
+    int nTargets = para.nTargets;
+    //load ground truth and parameters of every target
+    vector<Mat> pos_gt(nTargets);
+    vector<Parameter> tpara(nTargets, para);
+    for(int k = 0; k < nTargets; ++k)
+    {
+        pos_gt[k] = utils::LoadPosGT(para,k);
+        tpara[k].nModes = utils::updateModeNum(pos_gt[k].row(para.startFrame-2));
+        //every target draws its own particle sequence
+        tpara[k].seed   = para.seed != 0 ? para.seed + k : 0;
+    }
+    //init filename
+    vector<string> filename(para.endFrame);
+    utils::GenImgName(filename,para);
+    //create result files
+    vector<ResultsWriter*> presults(nTargets);
+    for(int k = 0; k < nTargets; ++k)
+    {
+        presults[k] = new ResultsWriter(".//results//" + para.file + utils::TargetSuffix(k),
+            para.file,para.dataset,para.resultsFormat);
+    }
+    //create targets from a single decoding of the first frame
+    vector<Mat> tarpos(nTargets);
+    for(int k = 0; k < nTargets; ++k)
+    {
+        tarpos[k] = pos_gt[k].row(0).clone();
+    }
+    FrameStore *store = OpenFrameStore(para,filename);
+    if(para.greyDetect)
+    {
+        DetectGreyscale(para,store ? store->frame(0) : imread(filename[0], -1));
+    }
+    CovImage covimg_init = LoadFrame(store,filename,0,tarpos,para);
+    vector<Cparticle> tarpar;
+    tarpar.reserve(nTargets);
+    for(int k = 0; k < nTargets; ++k)
+    {
+        tarpar.push_back(Cparticle(covimg_init,tpara[k],tarpos[k]));
+    }
+    AsyncRenderer *renderer = para.render ? new AsyncRenderer(para) : NULL;
+    bool show = interactive && para.display;
+    Profiler prof(para.file);
+    StartProfile(prof, para);
+    //tracking start
+    for(int i = para.startFrame - 1; i < para.endFrame; ++i)
+    {
+        prof.beginFrame(i+1);
+        //load new frame covering the search areas of all targets
+        for(int k = 0; k < nTargets; ++k)
+        {
+            tarpos[k] = tarpar[k].m_pos;
+        }
+        int64 t = getTickCount();
+        CovImage covimg = LoadFrame(store,filename,i,tarpos,para);
+        double tLoad = LapMs(t);
+        if(interactive)
+        {
+            cout<<"Frame "<<i+1<<"..."<<endl;
+        }
+        RenderFrame frame;
+        if(renderer)
+        {
+            frame = AsyncRenderer::snapshot(covimg,i+1);
+        }
+        for(int k = 0; k < nTargets; ++k)
+        {
+            //search
+            LapMs(t);
+            tarpar[k].m_pos = utils::SearchParticle(covimg,tarpar[k],tpara[k],pos_gt[k].row(i)).clone();
+            FrameRecord rec = SearchRecord(i,tarpar[k],tpara[k]);
+            rec.tLoad   = tLoad;
+            rec.tSearch = LapMs(t);
+            if(interactive && (tpara[k].cascade || tpara[k].adaptive || tpara[k].budgetMs > 0))
+            {
+                utils::LogSearchStats(tpara[k]);
+            }
+            //model update
+            LapMs(t);
+            tarpar[k].updateModel(covimg,tpara[k],i);
+            rec.tUpdate = LapMs(t);
+            //resampling
+            tarpar[k].ResampleParticle(tpara[k]);
+            rec.tResample = LapMs(t);
+            //draw results
+            if(renderer)
+            {
+                frame.targets.push_back(AsyncRenderer::snapshot(tarpar[k],tpara[k],pos_gt[k].row(i)));
+            }
+            if(show)
+            {
+                utils::DrawResults(covimg.im_in,tarpar[k],tpara[k],pos_gt[k].row(i));
+            }
+            //write results to file
+            presults[k]->append(rec);
+        }
+        //show results
+        if(renderer)
+        {
+            renderer->push(frame);
+        }
+        if(show)
+        {
+            utils::ShowFrame(covimg,para);
+        }
+        prof.endFrame();
+    }
+    delete renderer;
+    delete store;
+    for(int k = 0; k < nTargets; ++k)
+    {
+        delete presults[k];
+        if(tpara[k].memo)
+        {
+            #pragma omp critical
+            utils::LogMemoStats(tarpar[k]);
+        }
+    }
+    if(show)
+    {
+        destroyAllWindows();
+    }
+    FinishProfile(prof,para);
+}
+
+/* track the single target of a video. Frames are shown, unless para.display is
+off, and logged only when interactive is set.
+*/
+static void TrackSingleTarget(Parameter &para, bool interactive)
+{
+    //load ground truth of position
+    Mat pos_gt = utils::LoadPosGT(para);
+    //decide the number of modes according to the number of particles
+    para.nModes = utils::updateModeNum(pos_gt.row(para.startFrame-2));
+    //init filename
+    vector<string> filename(para.endFrame);
+    utils::GenImgName(filename,para);
+    //create result file
+    ResultsWriter presults(".//results//" + para.file,para.file,para.dataset,para.resultsFormat);
+    //create target
+    FrameStore *store = OpenFrameStore(para,filename);
+    if(para.greyDetect)
+    {
+        DetectGreyscale(para,store ? store->frame(0) : imread(filename[0], -1));
+    }
+    Mat pos_init = pos_gt.row(0).clone();
+    CovImage covimg_init = LoadFrame(store,filename,0,pos_init,para);
+    Cparticle tarpar(covimg_init,para,pos_init);
+    AsyncRenderer *renderer = para.render ? new AsyncRenderer(para) : NULL;
+    bool show = interactive && para.display;
+    Profiler prof(para.file);
+    StartProfile(prof, para);
+    //tracking start
+    for(int i = para.startFrame - 1; i < para.endFrame; ++i)
+    {
+        prof.beginFrame(i+1);
+        //load new frame 
+        //CovImage covimg(filename[i]);
+        int64 t = getTickCount();
+        CovImage covimg = LoadFrame(store,filename,i,tarpar.m_pos,para);
+        double tLoad = LapMs(t);
+        if(interactive)
+        {
+            cout<<"Frame "<<i+1<<"..."<<endl;
+        }
+        //search
+        LapMs(t);
+        tarpar.m_pos = utils::SearchParticle(covimg,tarpar,para,pos_gt.row(i)).clone();
+        FrameRecord rec = SearchRecord(i,tarpar,para);
+        rec.tLoad   = tLoad;
+        rec.tSearch = LapMs(t);
+        if(interactive && (para.cascade || para.adaptive || para.budgetMs > 0))
+        {
+            utils::LogSearchStats(para);
+        }
+        //model update
+        LapMs(t);
+        tarpar.updateModel(covimg,para,i);
+        rec.tUpdate = LapMs(t);
+        //resampling
+        tarpar.ResampleParticle(para);
+        rec.tResample = LapMs(t);
+        //show results
+        if(renderer)
+        {
+            RenderFrame frame = AsyncRenderer::snapshot(covimg,i+1);
+            frame.targets.push_back(AsyncRenderer::snapshot(tarpar,para,pos_gt.row(i)));
+            renderer->push(frame);
+        }
+        if(show)
+        {
+            utils::ShowResults(covimg,i,tarpar, para, pos_gt.row(i));
+        }
+        //cout<<tarpar.m_pos<<endl;
+        //cout<<utils::calcIOUscore(pos_gt.row(i),tarpar.m_pos)<<endl;
+        //write results to file
+        presults.append(rec);
+        prof.endFrame();
+    }
+    presults.flush();
+    delete renderer;
+    delete store;
+    if(para.memo)
+    {
+        #pragma omp critical
+        utils::LogMemoStats(tarpar);
+    }
+    if(show)
+    {
+        destroyAllWindows();
+    }
+    FinishProfile(prof,para);
+}
+
+static void TrackVideo(Parameter &para, bool interactive)
+{
+    //the rest of a frame decoded by regions is black, it is not shown
+    para.roiDecode = para.roiDecode && !(interactive && para.display) && !para.render;
+    if(para.nTargets > 1)
+    {
+        TrackMultiTarget(para,interactive);
+    }
+    else
+    {
+        TrackSingleTarget(para,interactive);
+    }
+}
+
+/* track all videos of the list concurrently on nWorkers threads. Every video
+has its own parameters, particles, RNG, result file and renderer, nothing
+is shown.
+The longest videos are started first to keep the makespan short.
+*/
+static void TrackBatch(vector<string> &video_list, int nWorkers)
+{
+    int nVideos = (int)video_list.size();
+    vector<Parameter> vpara(nVideos);
+    vector<pair<int,int> > order(nVideos);
+    for(int v = 0; v < nVideos; ++v)
+    {
+        vpara[v].file = video_list[v];
+        cerr<<"Video title: "<<vpara[v].file<<endl;
+        utils::InitPara(vpara[v]);
+        order[v] = make_pair(-(vpara[v].endFrame - vpara[v].startFrame + 1), v);
+    }
+    sort(order.begin(),order.end());
+    vector<double> seconds(nVideos,0);
+    int64 start = getTickCount();
+    #pragma omp parallel for schedule(dynamic,1) num_threads(nWorkers)
+    for(int n = 0; n < nVideos; ++n)
+    {
+        int v = order[n].second;
+        int64 t = getTickCount();
+        TrackVideo(vpara[v],false);
+        seconds[v] = (getTickCount() - t) / getTickFrequency();
+        #pragma omp critical
+        cerr<<"Finished "<<vpara[v].file<<" in "<<seconds[v]<<"s"<<endl;
+    }
+    double total = (getTickCount() - start) / getTickFrequency();
+    //summary
+    cout<<"video\tframes\tseconds\tfps"<<endl;
+    for(int v = 0; v < nVideos; ++v)
+    {
+        int frames = vpara[v].endFrame - vpara[v].startFrame + 1;
+        cout<<vpara[v].file<<"\t"<<frames<<"\t"<<seconds[v]<<"\t"
+            <<(seconds[v] > 0 ? frames / seconds[v] : 0)<<endl;
+    }
+    cout<<"total: "<<total<<"s on "<<nWorkers<<" workers"<<endl;
+}
+
+/* track the first target of a video with para over frames decoded
+beforehand and return the tracked boxes, one row per frame. Nothing is shown
+or written.
+*/
+static Mat TrackFrames(Parameter &para, vector<Mat> &frames, Mat &pos_gt)
+{
+    Mat track = Mat::zeros(para.endFrame,4,CV_64F);
+    Mat pos = pos_gt.row(0).clone();
+    CovImage covimg_init(frames[0],pos);
+    Cparticle tarpar(covimg_init,para,pos);
+    for(int i = para.startFrame - 1; i < para.endFrame; ++i)
+    {
+        CovImage covimg(frames[i],tarpar.m_pos);
+        tarpar.m_pos = utils::SearchParticle(covimg,tarpar,para,pos_gt.row(i)).clone();
+        tarpar.updateModel(covimg,para,i);
+        tarpar.ResampleParticle(para);
+        Mat row = track.row(i);
+        tarpar.m_pos.copyTo(row);
+    }
+    return track;
+}
+
+/* run every parameter set of para.sweepFile on every video. The frames of a
+video are decoded once and shared by all sets, which run in parallel. One
+table with the mean IoU, the success rate (IoU >= 0.5), the success AUC, the
+precision at 20 pixels and the speed of every video and set is written to
+results/sweep.txt.
+*/
+static void TrackSweep(vector<string> &video_list, Parameter &common)
+{
+    vector<vector<pair<string,double> > > settings;
+    utils::LoadSweep(common.sweepFile,settings);
+    int nSettings = (int)settings.size();
+    int nWorkers  = common.batchWorkers > 0 ? common.batchWorkers : omp_get_max_threads();
+    cerr<<nSettings<<" parameter sets on "<<nWorkers<<" workers"<<endl;
+
+    ofstream table(".//results//sweep.txt",ios::trunc);
+    table<<"video\tset\tstd_x\tstd_y\tstd_gain_w\tstd_gain_h\tnParticles"
+         <<"\tupdateFreq\ttemplates\tseed\tmeanIoU\tsuccess\tAUC\tprec20\tfps"<<endl;
+    for(int v = 0; v < video_list.size(); ++v)
+    {
+        if(video_list[v].empty())
+        {
+            continue;
+        }
+        Parameter para;
+        para.file = video_list[v];
         cerr<<"Video title: "<<para.file<<endl;
         utils::InitPara(para);
-        //load ground truth of position
+        para.display = 0;
+        para.render  = 0;
         Mat pos_gt = utils::LoadPosGT(para);
-        //decide the number of modes according to the number of particles
         para.nModes = utils::updateModeNum(pos_gt.row(para.startFrame-2));
-        //init filename
         vector<string> filename(para.endFrame);
         utils::GenImgName(filename,para);
-        //create result file
-        ofstream  presults;
-        presults.open(".//results//" + para.file + ".txt",ios::trunc);
-        presults<<para.file<<" "<<para.dataset<<endl;
-        //create target
-        Cparticle tarpar(filename[0],para,pos_gt);
-        //tracking start
+        //decode the frames once, or map them from the frame store
+        vector<Mat> frames(para.endFrame);
+        FrameStore *store = OpenFrameStore(para,filename);
+        #pragma omp parallel for schedule(dynamic,8) num_threads(nWorkers)
+        for(int i = 0; i < para.endFrame; ++i)
+        {
+            if(i == 0 || i >= para.startFrame - 1)
+            {
+                frames[i] = store ? store->frame(i) : imread(filename[i], -1);
+            }
+        }
+        //neutral colour frames are converted once, for all parameter sets
+        DetectGreyscale(para,frames[0]);
+        if(para.greyscale)
+        {
+            #pragma omp parallel for schedule(dynamic,8) num_threads(nWorkers)
+            for(int i = 0; i < para.endFrame; ++i)
+            {
+                if(!frames[i].empty())
+                {
+                    cvtColor(frames[i], frames[i], CV_BGR2GRAY);
+                }
+            }
+        }
+        //run all parameter sets against the shared frames
+        vector<Parameter> spara(nSettings, para);
+        vector<Mat> tracks(nSettings);
+        vector<double> seconds(nSettings, 0);
+        //nParticles of every set as configured, KLD-sampling changes it
+        vector<int> particles(nSettings, 0);
+        #pragma omp parallel for schedule(dynamic,1) num_threads(nWorkers)
+        for(int n = 0; n < nSettings; ++n)
+        {
+            for(int j = 0; j < settings[n].size(); ++j)
+            {
+                utils::SetParameter(spara[n],settings[n][j].first,settings[n][j].second);
+            }
+            particles[n] = spara[n].nParticles;
+            int64 t = getTickCount();
+            tracks[n]  = TrackFrames(spara[n],frames,pos_gt);
+            seconds[n] = (getTickCount() - t) / getTickFrequency();
+        }
+        int nFrames = para.endFrame - para.startFrame + 1;
+        vector<int> frames_no;
         for(int i = para.startFrame - 1; i < para.endFrame; ++i)
         {
-            //load new frame 
-            //CovImage covimg(filename[i]);
-            CovImage covimg(filename[i],tarpar.m_pos);
-            cout<<"Frame "<<i+1<<"..."<<endl;
-            //search
-            tarpar.m_pos = utils::SearchParticle(covimg,tarpar,para,pos_gt.row(i)).clone();
-            //model update
-            tarpar.updateModel(covimg,para,i);
-            //resampling
-            tarpar.ResampleParticle(para);
-            //show results
-            utils::ShowResults(covimg,i,tarpar.m_pos, para, pos_gt.row(i));
-            //cout<<tarpar.m_pos<<endl;
-            //cout<<utils::calcIOUscore(pos_gt.row(i),tarpar.m_pos)<<endl;
-            //write results to file
-            presults<<i+1<<" "<<para.currentMode+1<<" "<<tarpar.m_pos<<endl;
+            frames_no.push_back(i+1);
         }
-        presults.close();
-        destroyAllWindows();
+        for(int n = 0; n < nSettings; ++n)
+        {
+            vector<double> iou, centreErr;
+            ope::FrameErrors(frames_no,tracks[n].rowRange(para.startFrame-1,para.endFrame),
+                pos_gt,iou,centreErr);
+            ope::Score score = ope::Summarise(para.file,iou,centreErr);
+            Parameter &p = spara[n];
+            table<<para.file<<"\t"<<n+1<<"\t"<<p.std_x<<"\t"<<p.std_y<<"\t"
+                 <<p.std_gain_w<<"\t"<<p.std_gain_h<<"\t"<<particles[n]<<"\t"
+                 <<p.updateFreq<<"\t"<<p.templateNo<<"\t"<<p.seed<<"\t"
+                 <<score.meanIoU<<"\t"<<score.success[50]<<"\t"<<score.auc<<"\t"
+                 <<score.prec20<<"\t"<<(seconds[n] > 0 ? nFrames/seconds[n] : 0)<<endl;
+        }
+        frames.clear();
+        delete store;
+    }
+    table.close();
+}
+
+/* "eval": evaluate the results of every video of the list against its
+ground truth, or "eval <results files>": evaluate the given files against
+<name>_gt.txt next to them when it exists, else against the ground truth of
+the video <name>. The table is printed and written to results/ope.txt.
+*/
+static void Evaluate(vector<string> &video_list, int nFiles, char **files)
+{
+    vector<string> runs, gts;
+    if(nFiles == 0)
+    {
+        const char *ext[3] = {".txt", ".csv", ".bin"};
+        for(int v = 0; v < video_list.size(); ++v)
+        {
+            if(video_list[v].empty())
+            {
+                continue;
+            }
+            Parameter para;
+            para.file = video_list[v];
+            utils::InitPara(para);
+            for(int k = 0; k < para.nTargets; ++k)
+            {
+                runs.push_back(".//results//" + para.file + utils::TargetSuffix(k)
+                    + ext[min(max(para.resultsFormat,0),2)]);
+                gts.push_back(para.route + para.file + "//gt" + utils::TargetSuffix(k) + ".txt");
+            }
+        }
+    }
+    for(int n = 0; n < nFiles; ++n)
+    {
+        string run = files[n];
+        size_t slash = run.find_last_of("/\\");
+        size_t dot   = run.rfind('.');
+        string dir   = slash == string::npos ? "" : run.substr(0,slash+1);
+        string name  = run.substr(dir.size(), dot == string::npos || dot < dir.size() ?
+            string::npos : dot - dir.size());
+        string gt    = dir + name + "_gt.txt";
+        if(!ifstream(gt.c_str()).is_open())
+        {
+            Parameter para;
+            para.file = name;
+            utils::InitPara(para);
+            gt = para.route + name + "//gt.txt";
+        }
+        runs.push_back(run);
+        gts.push_back(gt);
+    }
+    stringstream table;
+    ope::EvaluateRuns(runs,gts,table);
+    cout<<table.str();
+    ofstream out(".//results//ope.txt",ios::trunc);
+    out<<table.str();
+}
+
+/* "pack [lab]": pack the frames of every video of the list into its frame
+store, in Lab with "lab". Tracking with frame_store set reads them from there.
+*/
+static int PackFrames(vector<string> &video_list, bool lab)
+{
+    int failures = 0;
+    for(int v = 0; v < video_list.size(); ++v)
+    {
+        if(video_list[v].empty())
+        {
+            continue;
+        }
+        Parameter para;
+        para.file = video_list[v];
+        cerr<<"Video title: "<<para.file<<endl;
+        utils::InitPara(para);
+        para.frameStore = lab ? 2 : 1;
+        vector<string> filename(para.endFrame);
+        utils::GenImgName(filename,para);
+        if(!FrameStore::pack(filename,FrameStorePath(para),lab))
+        {
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+/* micro-benchmarks, Benchmark.cpp */
+int mainbench(int argc, char** argv);
+/* differential test of the kernels, DiffTest.cpp */
+int maindifftest(int argc, char** argv);
+
+int main(int argc, char** argv)
+{
+    if(argc > 1 && string(argv[1]) == "bench")
+    {
+        return mainbench(argc-2,argv+2);
+    }
+    if(argc > 1 && string(argv[1]) == "difftest")
+    {
+        return maindifftest(argc-2,argv+2);
+    }
+    vector<string> video_list;
+    utils::LoadVideoList(video_list);
+    if(argc > 1 && string(argv[1]) == "eval")
+    {
+        Evaluate(video_list,argc-2,argv+2);
+        return 0;
+    }
+    if(argc > 1 && string(argv[1]) == "pack")
+    {
+        return PackFrames(video_list,argc > 2 && string(argv[2]) == "lab");
+    }
+
+    Parameter para;
+    //the sweep and the size of the worker pool are common parameters
+    para.file = video_list[0];
+    utils::InitPara(para);
+    if(!para.sweepFile.empty())
+    {
+        TrackSweep(video_list,para);
+        return 0;
+    }
+    if(para.batchWorkers > 0)
+    {
+        TrackBatch(video_list,para.batchWorkers);
+        Profiler::writeSummary(".//results//profile.json");
+        return 0;
+    }
+    for(int video_count = 0; video_count < video_list.size(); ++video_count)
+    {
+        //load parameters from config.ini
+        para.file = video_list[video_count];
+        cerr<<"Video title: "<<para.file<<endl;
+        utils::InitPara(para);
+        TrackVideo(para,true);
     }
+    Profiler::writeSummary(".//results//profile.json");
     //system("shutdown -h");
     return 0;
 }
@@ -11,12 +11,18 @@
 #include <sstream>
 #include <string>
 #include <fstream>
+#include <algorithm>
 
 #include "covImage.h" 
 #include "debug.h"
 #include "utils.h"
 #include "Cparticle.h"
 #include "SParater.h"
+#include "AsyncRenderer.h"
+#include "ResultsWriter.h"
+#include "OPE.h"
+#include "Profiler.h"
+#include "FrameStore.h"
 
 using namespace std;
 using namespace cv;
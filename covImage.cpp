@@ -20,48 +20,243 @@
 #include "covImage.h"
 #include "debug.h"
 
+#ifdef COV_USE_TURBOJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
 
 /* ------------------------------------------------------------ */
-void CovImage::SetSearchArea(Mat &tarpos){
+vector<int> CovImage::calcSearchArea(const Mat &tarpos){
     //SearchArea: x1,y1,x2,y2
     //(x1,y1) is the top left corner 
     //(x1,y2) is the bottom right corner
-    mSearchArea.resize(4);
-    double *ptarpos     = tarpos.ptr<double>(0);
+    vector<int> searchArea(4);
+    const double *ptarpos = tarpos.ptr<double>(0);
     double TargetWidth  = *(ptarpos+2) - *(ptarpos);
     double TargetHeight = *(ptarpos+3) - *(ptarpos+1); 
     //cout<<TargetHeight<<" "<<TargetWidth<<endl;
     double SearchAreaMargin = TargetHeight > TargetWidth ? 
                               TargetWidth : TargetHeight;
 
-    mSearchArea[0]          = *ptarpos - SearchAreaMargin <= 0 ? 
+    searchArea[0]          = *ptarpos - SearchAreaMargin <= 0 ? 
         0 : (int)(*ptarpos - SearchAreaMargin);
-    mSearchArea[1]         = *(ptarpos+1) - SearchAreaMargin <= 0 ?
+    searchArea[1]         = *(ptarpos+1) - SearchAreaMargin <= 0 ?
         0 : (int)(*(ptarpos+1) - SearchAreaMargin);
-    mSearchArea[2]     = *(ptarpos+2) + SearchAreaMargin >= nCols ?
+    searchArea[2]     = *(ptarpos+2) + SearchAreaMargin >= nCols ?
 nCols : (int)(*(ptarpos+2) + SearchAreaMargin);
-    mSearchArea[3]     = *(ptarpos+3) + SearchAreaMargin >= nRows ?
+    searchArea[3]     = *(ptarpos+3) + SearchAreaMargin >= nRows ?
 nRows : (int)(*(ptarpos+3) + SearchAreaMargin);
+    return searchArea;
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::SetSearchArea(Mat &tarpos){
+    mSearchArea = calcSearchArea(tarpos);
+    mROIs.assign(1, mSearchArea);
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::SetSearchAreas(const vector<Mat> &tarpos){
+    mROIs.clear();
+    for (int k = 0; k < tarpos.size(); k++)
+    {
+        mROIs.push_back(calcSearchArea(tarpos[k]));
+    }
+    // merge the regions that overlap or touch until all of them are
+    // disjoint. The integral image of each region is computed separately,
+    // so two regions must not share a border row or column.
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (int i = 0; i < mROIs.size() && !merged; i++)
+        {
+            for (int j = i+1; j < mROIs.size() && !merged; j++)
+            {
+                vector<int> &a = mROIs[i];
+                vector<int> &b = mROIs[j];
+                if (a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3])
+                {
+                    a[0] = min(a[0], b[0]); a[1] = min(a[1], b[1]);
+                    a[2] = max(a[2], b[2]); a[3] = max(a[3], b[3]);
+                    mROIs.erase(mROIs.begin() + j);
+                    merged = true;
+                }
+            }
+        }
+    }
+    // the bounding box of all regions is kept as the search area
+    mSearchArea = mROIs[0];
+    for (int k = 1; k < mROIs.size(); k++)
+    {
+        mSearchArea[0] = min(mSearchArea[0], mROIs[k][0]);
+        mSearchArea[1] = min(mSearchArea[1], mROIs[k][1]);
+        mSearchArea[2] = max(mSearchArea[2], mROIs[k][2]);
+        mSearchArea[3] = max(mSearchArea[3], mROIs[k][3]);
+    }
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::decode(const string &filename, bool grey){
+    PROF_SCOPE(PROF_DECODE);
+    // grey: the decoder converts the colour file itself
+    im_in = imread(filename, grey ? 0 : -1);
+    initSize();
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::setFrame(const Mat &frame, bool grey){
+    if (grey && frame.type() == CV_8UC3)
+    {
+        PROF_SCOPE(PROF_DECODE);
+        cvtColor(frame, im_in, CV_BGR2GRAY);
+    }
+    else
+    {
+        im_in = frame;
+    }
+    initSize();
+}
+
+/* ------------------------------------------------------------ */
+#ifdef COV_USE_TURBOJPEG
+/* libjpeg error handler returning to the decoder instead of exiting */
+struct JpegError
+{
+    jpeg_error_mgr mgr;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr cinfo)
+{
+    longjmp(((JpegError *)cinfo->err)->jump, 1);
+}
+#endif
+
+bool CovImage::decodeROI(const string &filename, const vector<Mat> &tarpos, bool grey){
+#ifdef COV_USE_TURBOJPEG
+    size_t dot = filename.rfind('.');
+    string ext = dot == string::npos ? "" : filename.substr(dot);
+    if (ext != ".jpg" && ext != ".JPG" && ext != ".jpeg" && ext != ".JPEG")
+    {
+        return false;
+    }
+    PROF_SCOPE(PROF_DECODE);
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+    {
+        return false;
+    }
+    jpeg_decompress_struct cinfo;
+    JpegError err;
+    cinfo.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = JpegErrorExit;
+    if (setjmp(err.jump))
+    {
+        // corrupt or unsupported file, imread decides what to do with it
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, fp);
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.num_components != 1 && cinfo.num_components != 3)
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        return false;
+    }
+    // the same channels as imread(filename, grey ? 0 : -1); libjpeg takes
+    // the luminance of a colour file and skips its colour conversion
+    int channels = grey ? 1 : cinfo.num_components;
+    cinfo.out_color_space = channels == 3 ? JCS_EXT_BGR : JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+
+    // the search areas need the size of the image, read from the header
+    im_in = Mat::zeros(cinfo.output_height, cinfo.output_width, CV_8UC(channels));
+    initSize();
+    SetSearchAreas(tarpos);
+    setWorkArea();
+
+    // decode the rows of mWork, cropped to the iMCU columns covering it.
+    // The chroma upsampling of the first and last cropped columns lacks
+    // their outer neighbour, so one more column is asked for on each side.
+    int cx1 = max(mWork.x - 1, 0);
+    int cx2 = min(mWork.x + mWork.width + 1, nCols);
+    JDIMENSION xoffset = cx1, width = cx2 - cx1;
+    jpeg_crop_scanline(&cinfo, &xoffset, &width);
+    jpeg_skip_scanlines(&cinfo, mWork.y);
+    while (cinfo.output_scanline < (JDIMENSION)(mWork.y + mWork.height))
+    {
+        JSAMPROW row = im_in.ptr<uchar>(cinfo.output_scanline) + xoffset * channels;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    // the rows below are not needed
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(fp);
+    return true;
+#else
+    (void)filename;
+    (void)tarpos;
+    (void)grey;
+    return false;
+#endif
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::initSize(){
+    nChannels = im_in.channels();
+    nRows = im_in.rows;
+    nCols = im_in.cols;
+    dim = nChannels*5 + 2;
+}
+
+/* ------------------------------------------------------------ */
+void CovImage::setWorkArea(){
+    mWork = Rect(0, 0, nCols, nRows);
+    if (mROIs.empty())
+    {
+        return;
+    }
+    int x1 = max(mSearchArea[0] - FEAT_HALO, 0);
+    int y1 = max(mSearchArea[1] - FEAT_HALO, 0);
+    int x2 = min(mSearchArea[2] + FEAT_HALO, nCols);
+    int y2 = min(mSearchArea[3] + FEAT_HALO, nRows);
+    // the border rules of the gradients need 3 rows and columns
+    if (x2 - x1 >= 3 && y2 - y1 >= 3)
+    {
+        mWork = Rect(x1, y1, x2 - x1, y2 - y1);
+    }
 }
 
 /* ------------------------------------------------------------ */
 void CovImage::imin_rgb2lab(){
-    if (im_in.channels() == 3){
+    PROF_SCOPE(PROF_LAB);
+    initSize();
+    setWorkArea();
+    // only the work area is converted, the rest of im is left undefined
+    im.create(nRows, nCols, CV_64FC(nChannels));
+    Mat src = im_in(mWork);
+    Mat dst = im(mWork);
+    if (src.type() == CV_32FC3){
+        //already converted to Lab, e.g. by a Lab frame store
+        src.convertTo(dst,CV_64F);
+    }
+    else if (nChannels == 3){
         //following these steps to convert RGB to 64FLab
         //rgb -> CV_32F -> Lab -> CV_64F
-        Mat tmp;
-        im_in.convertTo(tmp,CV_32F);
+        Mat tmp, lab;
+        src.convertTo(tmp,CV_32F);
         tmp *= 1./255;
-        cvtColor(tmp,im,CV_BGR2Lab);
-        im.convertTo(im,CV_64F);
+        cvtColor(tmp,lab,CV_BGR2Lab);
+        lab.convertTo(dst,CV_64F);
     }
     else{
-        im_in.convertTo(im,CV_64F);
+        src.convertTo(dst,CV_64F);
     }
-    nChannels = im.channels();
-    nRows = im.rows;
-    nCols = im.cols;
-    dim = nChannels*5 + 2;
     /*
     cerr << "nRows = " << nRows << " Ncols = " << nCols;
     cerr << " dim = " << dim << "\n";
@@ -72,43 +267,45 @@ void CovImage::imin_rgb2lab(){
 void CovImage::process()
 {
     assert(dim == FEAT_DIM1 || dim == FEAT_DIM3);
-
-    // initialize featimage
-    if (dim == FEAT_DIM1)
     {
-        featimage = Mat_<Vec<double,FEAT_DIM1> >(nRows, nCols);
-    }
-    else
-    {
-        featimage = Mat_<Vec<double,FEAT_DIM3> >(nRows, nCols);
-    }
-
-    coordinateX();
-    coordinateY();
-
-    //  		cerr << "coordinateX() done\n";
-    //  		debug::printDoubleMat(featimage, 0);
-    //  		cerr << "coordinateY() done\n";
-    //  		debug::printDoubleMat(featimage, 1);
-
-
-    for (int c=0; c < nChannels; c++) {
-        intensity(c);
-        gradientX(c);
-        gradientY(c);  // should be in channel 2+2*nChannels+c
-        gradient2X(c); // channel 2+3*nChannels+c
-        gradient2Y(c); // channel 2+4*nChannels+c
+        PROF_SCOPE(PROF_FEATURES);
+        // initialize featimage
+        if (dim == FEAT_DIM1)
+        {
+            featimage = Mat_<Vec<double,FEAT_DIM1> >(nRows, nCols);
+        }
+        else
+        {
+            featimage = Mat_<Vec<double,FEAT_DIM3> >(nRows, nCols);
+        }
 
-        //          cerr << "intensity() channel " << c << " done\n";
-        //          debug::printDoubleMat(featimage, 2+c);
-        //          cerr << "gradientX() channel " << c << " done\n";
-        //          debug::printDoubleMat(featimage, 2+nChannels+c);
-        // 			cerr << "gradientY() channel " << c << " done\n";
-        // 			debug::printDoubleMat(featimage, 2+2*nChannels+c);
-        // 			cerr << "gradient2X() channel " << c << " done\n";
-        // 			debug::printDoubleMat(featimage, 2+3*nChannels+c);
-        // 			cerr << "gradient2Y() channel " << c << " done\n";
-        // 			debug::printDoubleMat(featimage, 2+4*nChannels+c);	
+        coordinateX();
+        coordinateY();
+
+        //  		cerr << "coordinateX() done\n";
+        //  		debug::printDoubleMat(featimage, 0);
+        //  		cerr << "coordinateY() done\n";
+        //  		debug::printDoubleMat(featimage, 1);
+
+
+        for (int c=0; c < nChannels; c++) {
+            intensity(c);
+            gradientX(c);
+            gradientY(c);  // should be in channel 2+2*nChannels+c
+            gradient2X(c); // channel 2+3*nChannels+c
+            gradient2Y(c); // channel 2+4*nChannels+c
+
+            //          cerr << "intensity() channel " << c << " done\n";
+            //          debug::printDoubleMat(featimage, 2+c);
+            //          cerr << "gradientX() channel " << c << " done\n";
+            //          debug::printDoubleMat(featimage, 2+nChannels+c);
+            // 			cerr << "gradientY() channel " << c << " done\n";
+            // 			debug::printDoubleMat(featimage, 2+2*nChannels+c);
+            // 			cerr << "gradient2X() channel " << c << " done\n";
+            // 			debug::printDoubleMat(featimage, 2+3*nChannels+c);
+            // 			cerr << "gradient2Y() channel " << c << " done\n";
+            // 			debug::printDoubleMat(featimage, 2+4*nChannels+c);	
+        }
     }
     computeIntegralImage();
 }
@@ -123,10 +320,12 @@ void CovImage::coordinateX()
     cerr << "(nRows,nCols) = ( " << featimage.rows << "," << featimage.cols << " )\n";
     cerr << "depth =  " << featimage.depth() << ", CV_64F = " << CV_64F << "\n";
     */
-    for (int r=0; r < nRows; r++) 
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for (int r=r1; r < r2; r++) 
     {
-        outptr = (double *)featimage.ptr<double>(r);
-        for (int c=0; c < nCols; c++, outptr += dim)
+        outptr = (double *)featimage.ptr<double>(r,c1);
+        for (int c=c1; c < c2; c++, outptr += dim)
         {
             *outptr = (double)c;
         }
@@ -137,10 +336,12 @@ void CovImage::coordinateX()
 void CovImage::coordinateY()
 {
     double *outptr;
-    for (int r=0; r < nRows; r++)
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for (int r=r1; r < r2; r++)
     {
-        outptr = (double *)featimage.ptr<double>(r) + 1;
-        for (int c=0; c < nCols; c++, outptr += dim)
+        outptr = (double *)featimage.ptr<double>(r,c1) + 1;
+        for (int c=c1; c < c2; c++, outptr += dim)
         {
             *outptr = (double)r;
         }
@@ -153,12 +354,14 @@ void CovImage::intensity(int channel)
     // uchar *inptr;
     double *inptr;
     double *outptr;
-    for(int r=0; r < nRows; r++)
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for(int r=r1; r < r2; r++)
     {
         // inptr = (uchar *)im.ptr<uchar>(r) + channel;
-        inptr = (double *)im.ptr<double>(r) + channel;
-        outptr = (double *)featimage.ptr<double>(r) + channel + 2;
-        for (int c=0; c < nCols; c++, inptr += nChannels, outptr += dim)
+        inptr = (double *)im.ptr<double>(r,c1) + channel;
+        outptr = (double *)featimage.ptr<double>(r,c1) + channel + 2;
+        for (int c=c1; c < c2; c++, inptr += nChannels, outptr += dim)
         {
             *outptr = (double)(*inptr);
         }
@@ -171,14 +374,16 @@ void CovImage::gradientX(int channel)
     double *inptr;  // pointing to intensity of the channel
     double *outptr; // pointing to gradient-x of the channel
     int offset = channel + 2;
-    for (int r=0; r < nRows; r++) 
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for (int r=r1; r < r2; r++) 
     {
-        inptr = (double *)featimage.ptr<double>(r) + offset;
-        outptr = (double *)featimage.ptr<double>(r) + nChannels + offset;
+        inptr = (double *)featimage.ptr<double>(r,c1) + offset;
+        outptr = (double *)featimage.ptr<double>(r,c1) + nChannels + offset;
         // set the Ix value at column 0 the same as column 1
         *outptr = (*(inptr+2*dim) - *inptr) / 2.0;
         inptr += dim; outptr += dim;
-        for (int c=1; c < nCols-1; c++, inptr += dim, outptr += dim)
+        for (int c=c1+1; c < c2-1; c++, inptr += dim, outptr += dim)
         {
             *outptr = (*(inptr+dim) - *(inptr-dim)) / 2.0;
         }
@@ -195,28 +400,30 @@ void CovImage::gradientY(int channel)
     double *outptr;  // pointing to gradient-y of the channel
 
     int offset = channel + 2;
-    for (int r = 1; r < nRows-1; r++)
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for (int r = r1+1; r < r2-1; r++)
     {
-        inptr1 = (double *)featimage.ptr<double>(r-1) + offset;
-        inptr2 = (double *)featimage.ptr<double>(r+1) + offset;
-        outptr = (double *)featimage.ptr<double>(r) + offset + nChannels*2;
-        for (int c=0; c < nCols; c++, inptr1 += dim, inptr2 += dim, outptr += dim)
+        inptr1 = (double *)featimage.ptr<double>(r-1,c1) + offset;
+        inptr2 = (double *)featimage.ptr<double>(r+1,c1) + offset;
+        outptr = (double *)featimage.ptr<double>(r,c1) + offset + nChannels*2;
+        for (int c=c1; c < c2; c++, inptr1 += dim, inptr2 += dim, outptr += dim)
         {
             *outptr = (*inptr2 - *inptr1) / 2.0;
         }
     }
     // set row 0 the same as row 1
-    outptr = (double *)featimage.ptr<double>(1) + offset + nChannels*2;
-    double *outptr2 = (double *)featimage.ptr<double>(0) + offset + nChannels*2;
-    for (int c=0; c < nCols; c++, outptr += dim, outptr2 += dim)
+    outptr = (double *)featimage.ptr<double>(r1+1,c1) + offset + nChannels*2;
+    double *outptr2 = (double *)featimage.ptr<double>(r1,c1) + offset + nChannels*2;
+    for (int c=c1; c < c2; c++, outptr += dim, outptr2 += dim)
     {
         *outptr2 = *outptr;
     }
 
     // set the last row the same as the second last row
-    outptr = (double *)featimage.ptr<double>(nRows-2) + offset + nChannels*2;
-    outptr2 = (double *)featimage.ptr<double>(nRows-1) + offset + nChannels*2;
-    for (int c=0; c < nCols; c++, outptr += dim, outptr2 += dim)
+    outptr = (double *)featimage.ptr<double>(r2-2,c1) + offset + nChannels*2;
+    outptr2 = (double *)featimage.ptr<double>(r2-1,c1) + offset + nChannels*2;
+    for (int c=c1; c < c2; c++, outptr += dim, outptr2 += dim)
     {
         *outptr2 = *outptr;
     }
@@ -228,14 +435,16 @@ void CovImage::gradient2X(int channel)
     double *inptr;  // pointing to intensity of the channel
     double *outptr; // pointing to gradient-x of the channel
     int offset = channel + 2;
-    for(int r=0; r < nRows; r++)
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for(int r=r1; r < r2; r++)
     {
-        inptr = (double *)featimage.ptr<double>(r) + offset;
-        outptr = (double *)featimage.ptr<double>(r) + nChannels*3 + offset;
+        inptr = (double *)featimage.ptr<double>(r,c1) + offset;
+        outptr = (double *)featimage.ptr<double>(r,c1) + nChannels*3 + offset;
         // set the Ix value at column 0 the same as column 1
         *outptr = (*(inptr+2*dim) - 2*(*(inptr+dim)) + *inptr) / 1.0;
         inptr += dim; outptr += dim;
-        for (int c=1; c < nCols-1; c++, inptr += dim, outptr += dim)
+        for (int c=c1+1; c < c2-1; c++, inptr += dim, outptr += dim)
         {
             *outptr = (*(inptr+dim) - 2 * (*inptr) + *(inptr-dim)) / 1.0;
         }
@@ -252,29 +461,31 @@ void CovImage::gradient2Y(int channel){
     double *outptr;  // pointing to gradient-y of the channel
 
     int offset = channel + 2;
-    for (int r = 1; r < nRows-1; r++)
+    int r1 = mWork.y, r2 = mWork.y + mWork.height;
+    int c1 = mWork.x, c2 = mWork.x + mWork.width;
+    for (int r = r1+1; r < r2-1; r++)
     {
-        inptr1 = (double *)featimage.ptr<double>(r-1) + offset;
-        inptr2 = (double *)featimage.ptr<double>(r+1) + offset;
-        inptr3 = (double *)featimage.ptr<double>(r) + offset;
-        outptr = (double *)featimage.ptr<double>(r) + offset + nChannels*4;
-        for (int c=0; c < nCols; c++, inptr1 += dim, inptr2 += dim, inptr3 += dim, outptr += dim)
+        inptr1 = (double *)featimage.ptr<double>(r-1,c1) + offset;
+        inptr2 = (double *)featimage.ptr<double>(r+1,c1) + offset;
+        inptr3 = (double *)featimage.ptr<double>(r,c1) + offset;
+        outptr = (double *)featimage.ptr<double>(r,c1) + offset + nChannels*4;
+        for (int c=c1; c < c2; c++, inptr1 += dim, inptr2 += dim, inptr3 += dim, outptr += dim)
         {
             *outptr = *inptr2 + *inptr1 - 2*(*inptr3);
         }
     }
     // set row 0 the same as row 1
-    outptr = (double *)featimage.ptr<double>(1) + offset + nChannels*4;
-    double *outptr2 = (double *)featimage.ptr<double>(0) + offset + nChannels*4;
-    for (int c=0; c < nCols; c++, outptr += dim, outptr2 += dim)
+    outptr = (double *)featimage.ptr<double>(r1+1,c1) + offset + nChannels*4;
+    double *outptr2 = (double *)featimage.ptr<double>(r1,c1) + offset + nChannels*4;
+    for (int c=c1; c < c2; c++, outptr += dim, outptr2 += dim)
     {
         *outptr2 = *outptr;
     }
 
     // set the last row the same as the second last row
-    outptr = (double *)featimage.ptr<double>(nRows-2) + offset + nChannels*4;
-    outptr2 = (double *)featimage.ptr<double>(nRows-1) + offset + nChannels*4;
-    for (int c=0; c < nCols; c++, outptr += dim, outptr2 += dim)
+    outptr = (double *)featimage.ptr<double>(r2-2,c1) + offset + nChannels*4;
+    outptr2 = (double *)featimage.ptr<double>(r2-1,c1) + offset + nChannels*4;
+    for (int c=c1; c < c2; c++, outptr += dim, outptr2 += dim)
     {
         *outptr2 = *outptr;
     }
@@ -283,6 +494,7 @@ void CovImage::gradient2Y(int channel){
 
 void CovImage::computeIntegralImage()
 {
+    PROF_SCOPE(PROF_INTEGRAL);
     // initialize and compute the integral image
     int L = total(dim);
     assert(L == II_DIM1 || L == II_DIM3);
@@ -298,17 +510,49 @@ void CovImage::computeIntegralImage()
     }
 
     IIprod.setTo(0.0);
+    IIsum.setTo(0.0);
+    // without a search area the whole image is integrated
+    if (mROIs.empty())
+    {
+        vector<int> roi(4);
+        roi[0] = 0; roi[1] = 0; roi[2] = nCols; roi[3] = nRows;
+        mROIs.push_back(roi);
+    }
+    for (int k = 0; k < mROIs.size(); k++)
+    {
+        integrateROI(mROIs[k]);
+    }
+#ifndef COV_NO_PROFILER
+    Profiler *prof = Profiler::current();
+    if (prof)
+    {
+        int64 pixels = 0;
+        for (int k = 0; k < mROIs.size(); k++)
+        {
+            pixels += (int64)(mROIs[k][2] - mROIs[k][0]) * (mROIs[k][3] - mROIs[k][1]);
+        }
+        prof->addPixels(pixels);
+        prof->addIntegralBytes((int64)(IIprod.total() * IIprod.elemSize() +
+            IIsum.total() * IIsum.elemSize()));
+    }
+#endif
+}
+/* ------------------------------------------------------------ */
+
+void CovImage::integrateROI(const vector<int> &roi)
+{
+    int L = total(dim);
     //for (int r=1; r < nRows+1; r++) 
-    for(int r = mSearchArea[1]+1; r < mSearchArea[3]+1; r++) 
+    for(int r = roi[1]+1; r < roi[3]+1; r++) 
     {
         double *featptr, *prodptr;
         vector<double *> ptr(dim);
         //featptr = (double *)featimage.ptr<double>(r-1);
         //prodptr = (double *)IIprod.ptr<double>(r,1);
         //for (int c=1; c < nCols+1; c++, featptr += dim)
-        featptr = (double *)featimage.ptr<double>(r-1,mSearchArea[0]);
-        prodptr = (double *)IIprod.ptr<double>(r,mSearchArea[0]+1);
-        for(int c=mSearchArea[0]+1; c < mSearchArea[2]+1; c++, featptr += dim) 
+        featptr = (double *)featimage.ptr<double>(r-1,roi[0]);
+        prodptr = (double *)IIprod.ptr<double>(r,roi[0]+1);
+        for(int c=roi[0]+1; c < roi[2]+1; c++, featptr += dim) 
         {
             // construct IIprod
             for(int d=0; d < dim; d++)
@@ -330,28 +574,30 @@ void CovImage::computeIntegralImage()
     * columns of 0 at the left. The #extra columns = dim
     */
 
-    IIsum.setTo(0.0);
     //for (int r=1; r < nRows+1; r++) 
-    for(int r=mSearchArea[1]+1; r < mSearchArea[3]+1; r++) 
+    for(int r=roi[1]+1; r < roi[3]+1; r++) 
     {
-        double *ptr = (double *)IIsum.ptr<double>(r) + dim;
-        double *inptr = (double *)featimage.ptr<double>(r-1);
-        memcpy(ptr, inptr, sizeof(double)*dim*nCols);
+        double *ptr = (double *)IIsum.ptr<double>(r,roi[0]+1);
+        double *inptr = (double *)featimage.ptr<double>(r-1,roi[0]);
+        memcpy(ptr, inptr, sizeof(double)*dim*(roi[2]-roi[0]));
     }
 
     /* now compute the cumulative sum along the rows then along the columns
+    * of the region only, so that the other regions are left untouched.
     */
+    Range rows(roi[1]+1, roi[3]+1);
+    Range cols(roi[0]+1, roi[2]+1);
     //for (int r=1; r < nRows+1; r++) 
-    for(int r=mSearchArea[1]+1; r < mSearchArea[3]+1; r++) 
+    for(int r=rows.start; r < rows.end; r++) 
     {
-        IIprod.row(r) += IIprod.row(r-1);
-        IIsum.row(r) += IIsum.row(r-1);
+        IIprod.row(r).colRange(cols) += IIprod.row(r-1).colRange(cols);
+        IIsum.row(r).colRange(cols) += IIsum.row(r-1).colRange(cols);
     }
     //for (int c=1; c < nCols+1; c++) 
-    for(int c=mSearchArea[0]+1; c < mSearchArea[2]+1; c++)
+    for(int c=cols.start; c < cols.end; c++)
     {
-        IIprod.col(c) += IIprod.col(c-1);
-        IIsum.col(c) += IIsum.col(c-1);
+        IIprod.col(c).rowRange(rows) += IIprod.col(c-1).rowRange(rows);
+        IIsum.col(c).rowRange(rows) += IIsum.col(c-1).rowRange(rows);
     }
 
 }
@@ -434,7 +680,8 @@ void CovImage::covComponentMatrices(double x1, double y1, double x2, double y2,
 
     Npixels = (x2-x1+1) *(y2-y1+1);
 
-    prodM = Mat_<double>(dim,dim,CV_64F);
+    // reuse the memory of the output matrices when their size is right
+    prodM.create(dim,dim,CV_64F);
     if (L == II_DIM1)
     {
         Vec<double,II_DIM1> pv1 = interpIIprod1(x1, y1);
@@ -459,7 +706,7 @@ void CovImage::covComponentMatrices(double x1, double y1, double x2, double y2,
                 }
             }
         }
-        sumM = Mat(sv); // sumM should be a dim x 1 matrix
+        Mat(sv,false).copyTo(sumM); // sumM should be a dim x 1 matrix
     }
     else
     {
@@ -485,7 +732,34 @@ void CovImage::covComponentMatrices(double x1, double y1, double x2, double y2,
                 }
             }
         }
-        sumM = Mat(sv); // sumM should be a dim x 1 matrix
+        Mat(sv,false).copyTo(sumM); // sumM should be a dim x 1 matrix
+    }
+}
+/* ------------------------------------------------------------ */
+
+void CovImage::meanVector(double x1, double y1, double x2, double y2, double *mean)
+{
+    assert(x2 > x1 && y2 > y1 && x1 >= 0 && y1 >= 0 &&
+        x2 < nCols && y2 < nRows);
+
+    double Npixels = (x2-x1+1) *(y2-y1+1);
+    if (dim == FEAT_DIM1)
+    {
+        Vec<double,FEAT_DIM1> sv = interpIIsum1(x2+1.0, y2+1.0) + interpIIsum1(x1, y1)
+            - interpIIsum1(x2+1.0, y1) - interpIIsum1(x1, y2+1.0);
+        for (int d = 0; d < dim; d++)
+        {
+            mean[d] = sv[d] / Npixels;
+        }
+    }
+    else
+    {
+        Vec<double,FEAT_DIM3> sv = interpIIsum3(x2+1.0, y2+1.0) + interpIIsum3(x1, y1)
+            - interpIIsum3(x2+1.0, y1) - interpIIsum3(x1, y2+1.0);
+        for (int d = 0; d < dim; d++)
+        {
+            mean[d] = sv[d] / Npixels;
+        }
     }
 }
 /* ------------------------------------------------------------ */
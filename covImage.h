@@ -16,6 +16,7 @@
 #include <assert.h>
 
 #include "debug.h"
+#include "Profiler.h"
 
 /* feature dimension of single-channel and 3-channel images */
 #define FEAT_DIM1 7
@@ -29,6 +30,12 @@
 #define II_DIM1 28
 #define II_DIM3 153
 
+/* pixels around the search areas whose features are computed as well. The
+* gradients of a pixel read its direct neighbours, so a halo of one pixel
+* gives the pixels of the search areas the values of a whole-image run.
+*/
+#define FEAT_HALO 1
+
 using namespace std;
 using namespace cv;
 
@@ -37,6 +44,15 @@ class CovImage {
 public:
     /*search area*/
     vector<int> mSearchArea;
+    /* disjoint regions (x1,y1,x2,y2) covered by the integral image. When
+    * several targets are tracked in the same frame, their search areas are
+    * merged so that overlapping parts are integrated only once.
+    */
+    vector<vector<int> > mROIs;
+    /* the bounding box of mROIs plus FEAT_HALO, or the whole image without
+    * search areas. im and featimage hold values only inside this area.
+    */
+    Rect mWork;
     /*input image*/
     Mat im_in;    
     /*image in Lab space*/
@@ -77,7 +93,7 @@ public:
     *   filename - the name of the image file.
     */
     CovImage(string filename) {
-        im_in = imread(filename, -1);
+        decode(filename);
         imin_rgb2lab();
         process();
     }
@@ -88,11 +104,18 @@ public:
     * Input parameter:
     *   filename - the name of the image file.
     *   tarpos   - position of the target in last frame
+    *   grey     - read a colour file as greyscale
+    *   roi      - decode only the search area of a JPEG file (needs
+    *              COV_USE_TURBOJPEG). The rest of im_in is black, so it is
+    *              meant for headless runs.
     */
-    CovImage(string filename, Mat &tarpos) {
-        im_in = imread(filename, -1);
-        imin_rgb2lab();      
-        SetSearchArea(tarpos);
+    CovImage(string filename, Mat &tarpos, bool grey = false, bool roi = false) {
+        if (!roi || !decodeROI(filename, vector<Mat>(1, tarpos), grey))
+        {
+            decode(filename, grey);
+            SetSearchArea(tarpos);
+        }
+        imin_rgb2lab();
 //         cout<<tarpos<<endl;
 //         cout<<im_in.rows<<" "<<im_in.cols<<endl;
 //         cout<<mSearchArea[0]<<" "<<mSearchArea[1]<<" "<<
@@ -100,6 +123,52 @@ public:
         process();
     }
 
+    /* Constructor. Read in a greyscale or colour image stored in the file
+    * and construct a CovImage object covering the search areas of several
+    * targets. The image is decoded once and a single integral image is built
+    * over the union of the search areas.
+    * Input parameter:
+    *   filename - the name of the image file.
+    *   tarpos   - positions of the targets in last frame
+    *   grey     - read a colour file as greyscale
+    *   roi      - decode only the search areas of a JPEG file
+    */
+    CovImage(string filename, vector<Mat> &tarpos, bool grey = false, bool roi = false) {
+        if (!roi || !decodeROI(filename, tarpos, grey))
+        {
+            decode(filename, grey);
+            SetSearchAreas(tarpos);
+        }
+        imin_rgb2lab();
+        process();
+    }
+
+
+    /* Constructor. Construct a CovImage object of the search area around
+    * the target from a frame that has already been decoded, e.g. a frame
+    * shared by several runs over the same sequence. The pixels of frame are
+    * shared, not copied, and are only written when results are drawn on
+    * im_in. A colour frame converted to greyscale is a copy.
+    * Input parameter:
+    *   frame    - the decoded image, as returned by imread.
+    *   tarpos   - position of the target in last frame
+    *   grey     - convert a BGR frame to greyscale
+    */
+    CovImage(const Mat &frame, Mat &tarpos, bool grey = false) {
+        setFrame(frame, grey);
+        SetSearchArea(tarpos);
+        imin_rgb2lab();
+        process();
+    }
+
+    /* Constructor. Same as above for the search areas of several targets.
+    */
+    CovImage(const Mat &frame, vector<Mat> &tarpos, bool grey = false) {
+        setFrame(frame, grey);
+        SetSearchAreas(tarpos);
+        imin_rgb2lab();
+        process();
+    }
 
     /* Constructor. Read in a greyscale image stored in text format in the
     * given file. This constructor should be used for debugging purpose.
@@ -111,6 +180,11 @@ public:
     {
         cerr << "constructor 2\n";
         im = debug::readTextFile(filename);
+        nChannels = im.channels();
+        nRows = im.rows;
+        nCols = im.cols;
+        dim = nChannels*5 + 2;
+        setWorkArea();
         process();
     }
 
@@ -140,7 +214,25 @@ public:
 public:
     /*  Set the search area */
     void SetSearchArea(Mat &tarpos);
-    /*  convert default rgb image to CV_64F Lab image */
+    /*  Set the search areas of several targets and merge the overlapping ones */
+    void SetSearchAreas(const vector<Mat> &tarpos);
+    /*  return the search area (x1,y1,x2,y2) around the target position */
+    vector<int> calcSearchArea(const Mat &tarpos);
+    /*  read the image file into im_in, as greyscale when grey is set */
+    void decode(const string &filename, bool grey = false);
+    /*  when the file is a JPEG and COV_USE_TURBOJPEG is set, read its size, set the
+    *   search areas of tarpos and decode only the rows and columns covering
+    *   mWork. Returns false when the whole file must be decoded instead. */
+    bool decodeROI(const string &filename, const vector<Mat> &tarpos, bool grey = false);
+    /*  use a decoded frame as im_in, converted from BGR to grey when grey is set */
+    void setFrame(const Mat &frame, bool grey = false);
+    /*  set nChannels, nRows, nCols and dim from im_in */
+    void initSize();
+    /*  set mWork from the search areas */
+    void setWorkArea();
+    /*  convert default rgb image to CV_64F Lab image, inside mWork only.
+    *   The search areas must be set before. A CV_32FC3 im_in is taken as
+    *   Lab already. */
     void imin_rgb2lab(); 
     /* this function contains a long sequence of operations. It is called by the constructor.*/
     void process();
@@ -169,6 +261,9 @@ public:
 
     void computeIntegralImage();
 
+    /* compute the integral image inside one region (x1,y1,x2,y2) of mROIs */
+    void integrateROI(const vector<int> &roi);
+
 
 public:
     /* return the total from 1 to S inclusive */
@@ -261,6 +356,12 @@ public:
     */
     //    Mat covMatrix(int x1, int y1, int x2, int y2, int &Npixels);
 
+    /* return the mean feature vector of the region bounded by (x1,y1) and
+    * (x2,y2). Only IIsum is looked up, so this is much cheaper than
+    * covComponentMatrices. The output array mean must hold dim values.
+    */
+    void meanVector(double x1, double y1, double x2, double y2, double *mean);
+
     //overload function for intepolating method
     void covComponentMatrices(double x1, double y1, double x2, double y2,
         Mat &prodM, Mat &sumM, double &Npixels);
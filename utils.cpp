@@ -6,6 +6,7 @@
 
 #include "utils.h"
 #include <fstream>
+#include <algorithm>
 
 
 void utils::LoadVideoList(vector<string> &video_list)
@@ -22,6 +23,102 @@ void utils::LoadVideoList(vector<string> &video_list)
 
 /* ------------------------------------------------------------ */
 
+void utils::LoadSweep(string filename, vector<vector<pair<string,double> > > &settings)
+{
+    ifstream inf(filename.c_str());
+    if(!inf.is_open())
+    {
+        ERROR_OUT__<<" cannot open "<<filename<<endl;
+        return;
+    }
+    string line;
+    while(getline(inf,line))
+    {
+        if(line.empty() || line[0] == '#' || line[0] == ';')
+        {
+            continue;
+        }
+        //every line is a grid: the cartesian product of its value lists
+        vector<vector<pair<string,double> > > grid(1);
+        stringstream sline(line);
+        string item;
+        while(sline>>item)
+        {
+            size_t eq = item.find('=');
+            if(eq == string::npos)
+            {
+                continue;
+            }
+            string key = item.substr(0,eq);
+            vector<double> values;
+            stringstream svalues(item.substr(eq+1));
+            string value;
+            while(getline(svalues,value,','))
+            {
+                values.push_back(atof(value.c_str()));
+            }
+            vector<vector<pair<string,double> > > expanded;
+            for(int g = 0; g < grid.size(); ++g)
+            {
+                for(int v = 0; v < values.size(); ++v)
+                {
+                    expanded.push_back(grid[g]);
+                    expanded.back().push_back(make_pair(key,values[v]));
+                }
+            }
+            grid.swap(expanded);
+        }
+        settings.insert(settings.end(),grid.begin(),grid.end());
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+bool utils::SetParameter(Parameter &para, const string &key, double value)
+{
+    if     (key == "std_x")      para.std_x      = value;
+    else if(key == "std_y")      para.std_y      = value;
+    else if(key == "std_gain_w") para.std_gain_w = value;
+    else if(key == "std_gain_h") para.std_gain_h = value;
+    else if(key == "nParticles") para.nParticles = (int)value;
+    else if(key == "updateFreq") para.updateFreq = (int)value;
+    else if(key == "templates")  para.templateNo = (int)value;
+    else if(key == "seed")       para.seed       = (int)value;
+    else
+    {
+        ERROR_OUT__<<" unknown sweep parameter "<<key<<endl;
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------ */
+
+bool utils::ParseArgs(int argc, char** argv, map<string,double> &args)
+{
+    bool ok = true;
+    for (int n = 0; n < argc; ++n)
+    {
+        string arg = argv[n];
+        size_t eq  = arg.find('=');
+        if (eq == string::npos)
+        {
+            continue;
+        }
+        string key = arg.substr(0, eq);
+        if (args.find(key) == args.end())
+        {
+            ERROR_OUT__<<" unknown argument "<<key<<endl;
+            ok = false;
+            continue;
+        }
+        args[key] = atof(arg.substr(eq + 1).c_str());
+    }
+    return ok;
+}
+
+/* ------------------------------------------------------------ */
+
 void utils::InitPara(Parameter &para)
 {
     cerr<<"Loading parameters...";
@@ -43,9 +140,45 @@ void utils::InitPara(Parameter &para)
     para.std_gain_w       = reader.GetReal("comman_para","std_gain_w",0.1);
     para.std_gain_h       = reader.GetReal("comman_para","std_gain_h",0.1);
     para.updateFreq       = reader.GetInteger("comman_para","updateFreq",0); 
+    para.seed             = reader.GetInteger("comman_para","seed",0);
+    para.nTargets         = reader.GetInteger(para.file,"ntargets",1);
+    para.cascade          = reader.GetInteger("comman_para","cascade",0);
+    para.cascadeKeep      = reader.GetReal("comman_para","cascade_keep",0.3);
+    para.abandonK         = reader.GetInteger("comman_para","abandon_k",0);
+    para.memo             = reader.GetInteger("comman_para","memo",0);
+    para.dense            = reader.GetInteger("comman_para","dense",0);
+    para.denseStride      = reader.GetInteger("comman_para","dense_stride",3);
+    para.budgetMs         = reader.GetReal("comman_para","budget_ms",0);
+    if (para.dense && para.budgetMs > 0)
+    {
+        //the dense pass evaluates every window, it has no deadline
+        cerr<<"budget_ms does not apply to the dense search, ignored"<<endl;
+        para.budgetMs = 0;
+    }
+    para.batchWorkers     = reader.GetInteger("comman_para","batch_workers",0);
+    para.display          = reader.GetInteger("comman_para","display",1);
+    para.render           = reader.GetInteger("comman_para","render",0);
+    para.renderDir        = reader.Get("comman_para","render_dir",".//render//");
+    para.renderQueue      = reader.GetInteger("comman_para","render_queue",8);
+    para.sweepFile        = reader.Get("comman_para","sweep","");
+    para.frameStore       = reader.GetInteger("comman_para","frame_store",0);
+    para.roiDecode        = reader.GetInteger("comman_para","roi_decode",0);
+    para.greyDetect       = reader.GetInteger("comman_para","grey_detect",0);
+    para.greyChroma       = reader.GetReal("comman_para","grey_chroma",3);
+    para.greyscale        = 0;
+    para.resultsFormat    = reader.GetInteger("comman_para","results_format",0);
+    para.profile          = reader.GetInteger("comman_para","profile",1);
+    para.perfCounters     = reader.GetInteger("comman_para","perf_counters",0);
+    para.profileAllocs    = reader.GetInteger("comman_para","profile_allocs",0);
+    para.adaptive         = reader.GetInteger("comman_para","adaptive",0);
+    para.minParticles     = reader.GetInteger("comman_para","min_particles",50);
+    para.maxParticles     = reader.GetInteger("comman_para","max_particles",1000);
+    para.kldEpsilon       = reader.GetReal("comman_para","kld_epsilon",0.05);
+    para.kldZ             = reader.GetReal("comman_para","kld_z",2.33);
+    para.kldBin           = reader.GetReal("comman_para","kld_bin",4);
 
     para.framelength      = para.endFrame - para.startFrame + 1;
-    para.templateNo       = 1;
+    para.templateNo       = reader.GetInteger("comman_para","templates",1);
 
     para.v9               = utils::CovmatQuadrantRef(9);
     para.v3               = utils::CovmatQuadrantRef(3);
@@ -104,15 +237,15 @@ Mat utils::InitModeTranMat(int nModes)
 
 /* ------------------------------------------------------------ */
 
-Mat utils::LoadPosGT(Parameter para)
+Mat utils::LoadPosGT(Parameter para, int targetNo)
 {
     cerr<<endl<<"Loading ground truth of target position...";
     const int coorcnt = 4; //number of coordinates
     Mat pos_gt    = Mat::zeros(para.endFrame, coorcnt, CV_64F);
 
     ifstream inf;
-    inf.open(para.route + para.file + "//gt.txt", ifstream::in);
-    if(inf == NULL) ERROR_OUT__;
+    inf.open(para.route + para.file + "//gt" + utils::TargetSuffix(targetNo) + ".txt", ifstream::in);
+    if(!inf.is_open()) ERROR_OUT__;
 
     char gt_sep;
 
@@ -140,6 +273,19 @@ Mat utils::LoadPosGT(Parameter para)
     return pos_gt;
 }
 
+/* ------------------------------------------------------------ */
+
+string utils::TargetSuffix(int targetNo)
+{
+    if (targetNo == 0)
+    {
+        return "";
+    }
+    stringstream sstr;
+    sstr<<targetNo+1;
+    return sstr.str();
+}
+
 /* ------------------------------------------------------------ */
 void utils::getQuadrants(int x1, int y1, int x2, int y2,
     int *qx1, int *qy1, int *qx2, int *qy2)
@@ -183,6 +329,36 @@ void utils::getHorizontalHalf(int x1, int y1, int x2, int y2,
 
 /* ------------------------------------------------------------ */
 
+bool utils::IsGreyscale(const Mat &frame, double maxChroma)
+{
+    if (frame.type() != CV_8UC3)
+    {
+        return false;
+    }
+    //histogram of the chroma of a sample of the pixels
+    vector<int> hist(256, 0);
+    int nSamples = 0;
+    for (int r = 0; r < frame.rows; r += 2)
+    {
+        const uchar *p = frame.ptr<uchar>(r);
+        for (int c = 0; c < frame.cols; c += 2, p += 6)
+        {
+            int bg = abs(p[0] - p[1]), gr = abs(p[1] - p[2]), br = abs(p[0] - p[2]);
+            ++hist[max(bg, max(gr, br))];
+            ++nSamples;
+        }
+    }
+    int rank = nSamples - nSamples / 100;
+    int chroma = 0, seen = hist[0];
+    while (seen < rank && chroma < 255)
+    {
+        seen += hist[++chroma];
+    }
+    return nSamples > 0 && chroma <= maxChroma;
+}
+
+/* ------------------------------------------------------------ */
+
 void utils::GenImgName(vector<string> &filename, Parameter para)
 {
     cerr<<"Generating image names...";
@@ -205,11 +381,12 @@ void utils::GenImgName(vector<string> &filename, Parameter para)
 
 /* ------------------------------------------------------------ */
 
-void utils::ModeTran(Parameter &para){
+void utils::ModeTran(Parameter &para, Cparticle &tarpar){
+    PROF_SCOPE(PROF_MODE);
     //finite state machine
     double *ptran_matrix = para.nModes == 9 ? 
         para.tran_matrix9.ptr<double>(para.previousMode):para.tran_matrix3.ptr<double>(para.previousMode);
-    Mat weighted_sum_prob = Cparticle::sum_prob.clone();
+    Mat weighted_sum_prob = tarpar.sum_prob.clone();
     double *psum         = weighted_sum_prob.ptr<double>(0);
     for(int i = 0; i < weighted_sum_prob.cols; ++i, ++psum, ++ptran_matrix)
     {
@@ -261,56 +438,315 @@ vector<vector<int>> utils::CovmatQuadrantRef(int nmodes){
 
 Mat utils::SearchParticle(CovImage &covimg, Cparticle &tarpar, Parameter &para, Mat pos_gt)
 {
-    Cparticle::par_dis  = Mat::zeros(para.nParticles, para.nModes, CV_64F);
-    Cparticle::par_prob = Mat::zeros(para.nParticles, para.nModes, CV_64F);
-    Cparticle::sum_prob = Mat::zeros(1, para.nModes, CV_64F);
-
+    if (para.dense)
+    {
+        return utils::DenseSearch(covimg, tarpar, para);
+    }
+    int64 start = getTickCount();
+    tarpar.par_dis  = Mat::zeros(para.nParticles, para.nModes, CV_64F);
+    tarpar.par_prob = Mat::zeros(para.nParticles, para.nModes, CV_64F);
+    tarpar.sum_prob = Mat::zeros(1, para.nModes, CV_64F);
+
+    tarpar.m_candidates.reserve(para, covimg.dim);
+    // modes that cannot follow the previous mode are never selected by
+    // ModeTran, so they are not evaluated
+    tarpar.m_candidates.setActiveModes(para.nModes == 9 ? 
+        para.tran_matrix9.ptr<double>(para.previousMode) :
+        para.tran_matrix3.ptr<double>(para.previousMode));
+
+    // the frame may hold the search areas of several targets
+    vector<int> searcharea = covimg.calcSearchArea(tarpar.m_pos);
+    vector<int> inside;
+    para.nOutside = para.nPruned = para.nEvaluated = para.nLate = 0;
     for(int j = 0; j < para.nParticles; ++j)
     {
-       // if (utils::IsParticleOutFrame(Cparticle::par_pos.row(j),covimg.im.rows,covimg.im.cols))
-       if (utils::IsParticleOutFrame(Cparticle::par_pos.row(j),covimg.mSearchArea))
+       // if (utils::IsParticleOutFrame(tarpar.par_pos.row(j),covimg.im.rows,covimg.im.cols))
+       if (utils::IsParticleOutFrame(tarpar.par_pos.row(j),searcharea))
        {
+            ++para.nOutside;
             continue; 
        }
-        Cparticle canpar(covimg,Cparticle::par_pos.row(j),para);
-        canpar.ParticleProcess(tarpar,j);
+       inside.push_back(j);
     }
-//     cout<<Cparticle::par_dis<<endl;
-//     cout<<Cparticle::par_prob<<endl;
-//     cout<<Cparticle::sum_prob<<endl;
+    {
+        PROF_SCOPE(PROF_PARTICLES);
+        if (para.cascade)
+        {
+            utils::CascadeReject(covimg, tarpar, para, inside);
+        }
+        if (para.budgetMs > 0)
+        {
+            // most promising particles first, so that the deadline cuts the
+            // least likely ones
+            utils::SortByPrediction(tarpar, inside);
+            int64 deadline = start + (int64)(para.budgetMs * 1e-3 * getTickFrequency());
+            int n = 0;
+            for(; n < inside.size(); ++n)
+            {
+                if (n > 0 && getTickCount() > deadline)
+                {
+                    break;
+                }
+                tarpar.ParticleProcess(covimg,para,inside[n]);
+            }
+            // the particles left have no probability, ModeTran and the
+            // resampling only see the evaluated ones
+            para.nEvaluated = n;
+            para.nLate      = (int)inside.size() - n;
+        }
+        else
+        {
+            for(int n = 0; n < inside.size(); ++n)
+            {
+                tarpar.ParticleProcess(covimg,para,inside[n]);
+            }
+            para.nEvaluated = (int)inside.size();
+        }
+    }
+//     cout<<tarpar.par_dis<<endl;
+//     cout<<tarpar.par_prob<<endl;
+//     cout<<tarpar.sum_prob<<endl;
     Mat max_prob_index = Mat::zeros(1, para.nModes,CV_32S);
-    utils::ProcessAllParticles(max_prob_index);
+    utils::ProcessAllParticles(tarpar, max_prob_index);
    
-    utils::ModeTran(para);
-    Mat final_pos = Cparticle::par_pos.row(max_prob_index.at<__int32>(0,para.currentMode));
+    utils::ModeTran(para, tarpar);
+    int best = max_prob_index.at<__int32>(0,para.currentMode);
+    para.bestDis  = tarpar.par_dis.at<double>(best,para.currentMode);
+    Mat final_pos = tarpar.par_pos.row(best);
   
     return final_pos;
 }
 
 /* ------------------------------------------------------------ */
 
-void utils::ShowResults(CovImage covimg, int frameNum ,  Mat final_pos, Parameter &para, Mat pos_gt){
+Mat utils::DenseSearch(CovImage &covimg, Cparticle &tarpar, Parameter &para)
+{
+    //windows of the target size strictly inside the search area
+    double *ppos  = tarpar.m_pos.ptr<double>(0);
+    double width  = *(ppos+2) - *ppos;
+    double height = *(ppos+3) - *(ppos+1);
+    vector<int> searcharea = covimg.calcSearchArea(tarpar.m_pos);
+    int stride = max(para.denseStride, 1);
+    double x0  = searcharea[0] + 1;
+    double y0  = searcharea[1] + 1;
+    int nx = (int)floor((searcharea[2] - 1 - width - x0) / stride) + 1;
+    int ny = (int)floor((searcharea[3] - 1 - height - y0) / stride) + 1;
+    if (nx <= 0 || ny <= 0)
+    {
+        //the search area is too small for a dense pass; the particle
+        //search records its mode, distance and counts in para
+        int dense  = para.dense;
+        para.dense = 0;
+        Mat final_pos = utils::SearchParticle(covimg, tarpar, para, Mat());
+        para.dense = dense;
+        return final_pos;
+    }
+    int nWin = nx * ny;
+
+    //the windows become the particle set of this frame, so that the
+    //resampling draws the next particles around the best windows
+    tarpar.par_pos.create(nWin, 4, CV_64F);
+    for (int n = 0; n < nWin; ++n)
+    {
+        double *p = tarpar.par_pos.ptr<double>(n);
+        *p     = x0 + (n % nx) * stride;
+        *(p+1) = y0 + (n / nx) * stride;
+        *(p+2) = *p + width;
+        *(p+3) = *(p+1) + height;
+    }
+    tarpar.par_dis  = Mat::zeros(nWin, para.nModes, CV_64F);
+    tarpar.par_prob = Mat::zeros(nWin, para.nModes, CV_64F);
+    tarpar.sum_prob = Mat::zeros(1, para.nModes, CV_64F);
+    const double *ptran = para.nModes == 9 ? 
+        para.tran_matrix9.ptr<double>(para.previousMode) :
+        para.tran_matrix3.ptr<double>(para.previousMode);
+
+    //every thread evaluates its windows in its own one-particle buffer
+    Parameter para_win = para;
+    para_win.nParticles = 1;
+    para_win.abandonK   = 0;
+    para_win.memo       = 0;
+    {
+        PROF_SCOPE(PROF_PARTICLES);
+#ifndef COV_NO_PROFILER
+        //the threads of the region add their stages to this profiler
+        Profiler *prof = Profiler::current();
+#endif
+        #pragma omp parallel
+        {
+            PROF_WORKER(prof);
+            ParticleBuffer buf;
+            buf.reserve(para_win, covimg.dim);
+            buf.setActiveModes(ptran);
+            #pragma omp for schedule(dynamic,16)
+            for (int n = 0; n < nWin; ++n)
+            {
+                buf.calccovmat(covimg, para_win, tarpar.par_pos.ptr<double>(n), 0);
+                buf.logm(0);
+                double *pdis  = tarpar.par_dis.ptr<double>(n);
+                double *pprob = tarpar.par_prob.ptr<double>(n);
+                for (int i = 0; i < para.nModes; ++i)
+                {
+                    if (buf.active[i])
+                    {
+                        pdis[i]  = tarpar.CandidateDistance(buf, 0, i);
+                        pprob[i] = 1/pdis[i];
+                    }
+                }
+            }
+        }
+    }
+    for (int n = 0; n < nWin; ++n)
+    {
+        tarpar.sum_prob += tarpar.par_prob.row(n);
+    }
+    para.nOutside = para.nPruned = para.nLate = 0;
+    para.nEvaluated = nWin;
+
+    Mat max_prob_index = Mat::zeros(1, para.nModes,CV_32S);
+    utils::ProcessAllParticles(tarpar, max_prob_index);
+    utils::ModeTran(para, tarpar);
+    //distance map of the selected mode
+    tarpar.m_dismap = tarpar.par_dis.col(para.currentMode).clone().reshape(1, ny);
+    int best = max_prob_index.at<__int32>(0,para.currentMode);
+    para.bestDis = tarpar.par_dis.at<double>(best,para.currentMode);
+    return tarpar.par_pos.row(best);
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::SortByPrediction(Cparticle &tarpar, vector<int> &inside)
+{
+    // with the random walk model the prediction is the last position
+    double *ppos = tarpar.m_pos.ptr<double>(0);
+    double cx = (*ppos + *(ppos+2)) / 2;
+    double cy = (*(ppos+1) + *(ppos+3)) / 2;
+    vector<pair<double,int> > order(inside.size());
+    for (int n = 0; n < inside.size(); ++n)
+    {
+        double *p = tarpar.par_pos.ptr<double>(inside[n]);
+        double dx = (*p + *(p+2)) / 2 - cx;
+        double dy = (*(p+1) + *(p+3)) / 2 - cy;
+        order[n] = make_pair(dx*dx + dy*dy, inside[n]);
+    }
+    sort(order.begin(), order.end());
+    for (int n = 0; n < inside.size(); ++n)
+    {
+        inside[n] = order[n].second;
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::CascadeReject(CovImage &covimg, Cparticle &tarpar, Parameter &para, vector<int> &inside)
+{
+    int nKeep = (int)ceil(para.cascadeKeep * inside.size());
+    nKeep = max(nKeep, 1);
+    if (nKeep >= (int)inside.size())
+    {
+        return;
+    }
+    //score all particles on the mean features of their quadrants
+    ParticleBuffer &buf = tarpar.m_candidates;
+    const double *ptar  = tarpar.m_meanDesc.ptr<double>(0);
+    int len             = tarpar.m_meanDesc.cols;
+    vector<pair<double,int> > score(inside.size());
+    for(int n = 0; n < inside.size(); ++n)
+    {
+        int k = inside[n];
+        double *pmean = buf.meanDesc.ptr<double>(k);
+        ParticleBuffer::calcmean(covimg, para.nModes, tarpar.par_pos.ptr<double>(k), pmean);
+        double d = 0;
+        for(int l = 0; l < len; ++l)
+        {
+            d += (pmean[l] - ptar[l]) * (pmean[l] - ptar[l]);
+        }
+        score[n] = make_pair(d, k);
+    }
+    //keep the nKeep closest ones
+    nth_element(score.begin(), score.begin() + nKeep, score.end());
+    para.nPruned = (int)inside.size() - nKeep;
+    inside.resize(nKeep);
+    for(int n = 0; n < nKeep; ++n)
+    {
+        inside[n] = score[n].second;
+    }
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::LogSearchStats(Parameter &para)
+{
+    cout<<"  particles: "<<para.nParticles<<", "
+        <<para.nOutside<<" outside search area, "
+        <<para.nPruned<<" pruned by cascade, "
+        <<para.nEvaluated<<" fully evaluated";
+    if (para.budgetMs > 0)
+    {
+        cout<<", "<<para.nLate<<" skipped at the deadline";
+    }
+    cout<<endl;
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::LogMemoStats(Cparticle &tarpar)
+{
+    ParticleBuffer &buf = tarpar.m_candidates;
+    cerr<<"Quadrant cache hits: "<<buf.compHits<<"/"<<buf.compLookups;
+    if (buf.compLookups > 0)
+    {
+        cerr<<" ("<<100.0*buf.compHits/buf.compLookups<<"%)";
+    }
+    cerr<<", box cache hits: "<<buf.boxHits<<"/"<<buf.boxLookups;
+    if (buf.boxLookups > 0)
+    {
+        cerr<<" ("<<100.0*buf.boxHits/buf.boxLookups<<"%)";
+    }
+    cerr<<endl;
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::ShowResults(CovImage covimg, int frameNum , Cparticle &tarpar, Parameter &para, Mat pos_gt){
+    PROF_SCOPE(PROF_DISPLAY);
 
     //tracking information
 //     stringstream ss;
 //     ss<<"frame "<<frameNum<<" mode "<<para.currentMode+1;
 //     putText(covimg.im_in,ss.str(),Point(10,15),CV_FONT_NORMAL,0.7,Scalar(0,0,0)); 
-    
+    utils::DrawResults(covimg.im_in, tarpar, para, pos_gt);
+    utils::ShowFrame(covimg, para);
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::DrawResults(Mat &canvas, Cparticle &tarpar, Parameter &para, Mat pos_gt){
+    const vector<int> &outline = para.nModes == 9 ? 
+        para.v_draw9[para.currentMode] : para.v_draw3[para.currentMode];
+    utils::DrawTarget(canvas, tarpar.m_pos, tarpar.par_pos.rowRange(0,para.nParticles),
+        para.nModes, outline, pos_gt);
+}
+
+/* ------------------------------------------------------------ */
+
+void utils::DrawTarget(Mat &canvas, Mat final_pos, Mat particles, int nModes, 
+    const vector<int> &outline, Mat pos_gt){
     /*
     show all the particles
     */
-    for (int i = 0; i < para.nParticles; i++)
+    for (int i = 0; i < particles.rows; i++)
     {
-        double *p =  Cparticle::par_pos.ptr<double>(i);
+        double *p =  particles.ptr<double>(i);
         Point a = Point(*p,*(p+1));
         Point b = Point(*(p+2),*(p+3));
-        rectangle(covimg.im_in,a,b,Scalar(0,0,0));
+        rectangle(canvas,a,b,Scalar(0,0,0));
     }
     /*
     show mode
     */
     vector<Point> point_draw;
-    if(para.nModes == 9)
+    if(nModes == 9)
     {
         point_draw.resize(9);
         double *pfinal_pos = final_pos.ptr<double>(0);
@@ -320,15 +756,8 @@ void utils::ShowResults(CovImage covimg, int frameNum ,  Mat final_pos, Paramete
         point_draw[0] = Point(x1,y1);   point_draw[1] = Point(xhalf,y1);   point_draw[2] = Point(x2,y1);
         point_draw[3] = Point(x1,yhalf);point_draw[4] = Point(xhalf,yhalf);point_draw[5] = Point(x2,yhalf);
         point_draw[6] = Point(x1,y2);   point_draw[7] = Point(xhalf,y2);   point_draw[8] = Point(x2,y2);
-        for(int i = 0; i < para.v_draw9[para.currentMode].size() - 1; i++)
-        {
-            line(covimg.im_in, 
-                point_draw[para.v_draw9[para.currentMode][i]],
-                point_draw[para.v_draw9[para.currentMode][i+1]],
-                Scalar(255,255,255));//white
-        }
     }
-    else if(para.nModes == 3)
+    else if(nModes == 3)
     {
         point_draw.resize(6);
         double *pfinal_pos = final_pos.ptr<double>(0);
@@ -338,29 +767,41 @@ void utils::ShowResults(CovImage covimg, int frameNum ,  Mat final_pos, Paramete
         point_draw[0] = Point(x1,y1);   point_draw[1] = Point(x2,y1);      
         point_draw[2] = Point(x1,yhalf);point_draw[3] = Point(x2,yhalf);
         point_draw[4] = Point(x1,y2);   point_draw[5] = Point(x2,y2);
-        for(int i = 0; i < para.v_draw3[para.currentMode].size() - 1; i++)
-        {
-            line(covimg.im_in, 
-                point_draw[para.v_draw3[para.currentMode][i]],
-                point_draw[para.v_draw3[para.currentMode][i+1]],
-                Scalar(255,255,255));//white
-        }
+    }
+    for(int i = 0; i + 1 < (int)outline.size(); i++)
+    {
+        line(canvas, 
+            point_draw[outline[i]],
+            point_draw[outline[i+1]],
+            Scalar(255,255,255));//white
     }
     //draw ground truth window
     double *p =  pos_gt.ptr<double>(0);
     Point  a  = Point(*p,*(p+1));
     Point  b  = Point(*(p+2),*(p+3));
-    rectangle(covimg.im_in,a,b,Scalar(0,0,0));//black
+    rectangle(canvas,a,b,Scalar(0,0,0));//black
+}
 
-    //draw search area 
-     a  = Point(covimg.mSearchArea[0],covimg.mSearchArea[1]);
-     b  = Point(covimg.mSearchArea[2],covimg.mSearchArea[3]);
-    rectangle(covimg.im_in,a,b,Scalar(0,255,255));//yellow
+/* ------------------------------------------------------------ */
 
+void utils::ShowFrame(CovImage &covimg, Parameter &para){
+    PROF_SCOPE(PROF_DISPLAY);
+    utils::DrawSearchAreas(covimg.im_in, covimg.mROIs);
     imshow(para.file,covimg.im_in);
     waitKey(1);
 }
 
+void utils::DrawSearchAreas(Mat &canvas, const vector<vector<int>> &rois){
+    for (int k = 0; k < rois.size(); k++)
+    {
+        Point a  = Point(rois[k][0],rois[k][1]);
+        Point b  = Point(rois[k][2],rois[k][3]);
+        rectangle(canvas,a,b,Scalar(0,255,255));//yellow
+    }
+}
+
+/* ------------------------------------------------------------ */
+
 /*  draw mode
 points definition
 0----1----2
@@ -460,9 +901,10 @@ double utils::calcIOUscore(Mat boxA, Mat boxB){
     return I/(areaA + areaB - I);
 }
 
-void utils::ProcessAllParticles(Mat &max_prob_index)
+void utils::ProcessAllParticles(Cparticle &tarpar, Mat &max_prob_index)
 {
-    Mat par_prob_t = Cparticle::par_prob.t();
+    PROF_SCOPE(PROF_MODE);
+    Mat par_prob_t = tarpar.par_prob.t();
     int *pmax_prob_index = max_prob_index.ptr<__int32>(0);
     for (int i = 0; i < max_prob_index.cols; ++i, ++pmax_prob_index)
     {
@@ -6,6 +6,8 @@
 #include "SParater.h"
 #include "cpp/INIReader.h"
 
+#include <map>
+
 namespace utils
 {
 
@@ -19,6 +21,27 @@ namespace utils
     .....
     */
     void InitPara(Parameter &para);
+    /*
+    read the parameter sets of a sweep. Every line of the file is a grid
+    such as
+        std_x=1,2,4 nParticles=100,200
+    which expands to the cartesian product of its value lists (6 sets here);
+    the sets of all lines are appended to settings. Empty lines and lines
+    starting with # or ; are skipped.
+    */
+    void LoadSweep(string filename, vector<vector<pair<string,double> > > &settings);
+    /*
+    set the parameter named key (std_x, std_y, std_gain_w, std_gain_h,
+    nParticles, updateFreq, templates or seed). Returns false for an
+    unknown key.
+    */
+    bool SetParameter(Parameter &para, const string &key, double value);
+    /*
+    read the key=value arguments of argv into args, which holds the known
+    keys with their default values. Arguments without '=' are skipped, an
+    unknown key is reported and returns false.
+    */
+    bool ParseArgs(int argc, char** argv, map<string,double> &args);
 
     /*
     .....
@@ -26,10 +49,16 @@ namespace utils
     Mat InitModeTranMat(int nModes);
 
     /*
-    return the ground truth of position
+    return the ground truth of position. targetNo selects the ground truth
+    file of the target when several targets are tracked in one video:
+    gt.txt for target 0, gt2.txt for target 1, ...
     */
 
-    Mat LoadPosGT(Parameter para);
+    Mat LoadPosGT(Parameter para, int targetNo = 0);
+    /*
+    return the suffix used in the file names of target targetNo
+    */
+    string TargetSuffix(int targetNo);
     
     /* Given the top-left and bottom-right corner coordinates of a image
     * region, this function returns the coordinates of the the four corners
@@ -58,10 +87,17 @@ namespace utils
     /*  ......
      */
     void GenImgName(vector<string> &filename, Parameter para);
+    /*
+    true when a BGR frame carries no colour: the 99th percentile of the
+    chroma, max(|B-G|, |G-R|, |B-R|) over every other pixel and row, is at
+    most maxChroma grey levels. Frames that are not 8-bit BGR are never
+    greyscale here.
+    */
+    bool IsGreyscale(const Mat &frame, double maxChroma);
     /* 
         normalize the weight of particles
     */
-    void ModeTran(Parameter &para);
+    void ModeTran(Parameter &para, Cparticle &tarpar);
     /*  
      * generate different modes
      */
@@ -70,10 +106,52 @@ namespace utils
     ...
      */
     Mat SearchParticle(CovImage &covimg, Cparticle &tarpar, Parameter &para, Mat pos_gt);
+    /*
+    exhaustive search: evaluate the target-sized window at every position
+    of the search area on a grid with step para.denseStride, in parallel.
+    The windows replace the particles of the frame, tarpar.m_dismap receives
+    the distance map of the selected mode and the best window is returned.
+    Called by SearchParticle when para.dense is set.
+     */
+    Mat DenseSearch(CovImage &covimg, Cparticle &tarpar, Parameter &para);
+    /*
+    order the particles in inside by the distance of their centre to the
+    predicted position of the target, nearest first
+     */
+    void SortByPrediction(Cparticle &tarpar, vector<int> &inside);
+    /*
+    first stage of the particle search: score the particles in inside on
+    the mean features of their quadrants and keep only the best
+    para.cascadeKeep fraction for the full covariance evaluation
+     */
+    void CascadeReject(CovImage &covimg, Cparticle &tarpar, Parameter &para, vector<int> &inside);
+    /*
+    print the number of particles of the last search and how many of them
+    each stage removed
+     */
+    void LogSearchStats(Parameter &para);
+    /*
+    print the hit rates of the descriptor caches of the target over the video
+     */
+    void LogMemoStats(Cparticle &tarpar);
     /*  
     ...
      */
-    void ShowResults(CovImage covimg, int frameNum , Mat final_pos, Parameter &para, Mat pos_gt);
+    void ShowResults(CovImage covimg, int frameNum , Cparticle &tarpar, Parameter &para, Mat pos_gt);
+    /*  draw the particles, the mode and the ground truth of one target
+     */
+    void DrawResults(Mat &canvas, Cparticle &tarpar, Parameter &para, Mat pos_gt);
+    /*  draw the particles, the mode outline and the ground truth of one target
+    from plain state, so that a snapshot can be drawn away from the tracker
+     */
+    void DrawTarget(Mat &canvas, Mat final_pos, Mat particles, int nModes, 
+        const vector<int> &outline, Mat pos_gt);
+    /*  draw the search areas
+     */
+    void DrawSearchAreas(Mat &canvas, const vector<vector<int>> &rois);
+    /*  draw the search areas and display the frame
+     */
+    void ShowFrame(CovImage &covimg, Parameter &para);
     /*  
     ...
      */
@@ -98,7 +176,7 @@ namespace utils
     /*
     ...
      */
-    void ProcessAllParticles(Mat &min_index);
+    void ProcessAllParticles(Cparticle &tarpar, Mat &min_index);
 };
 
 #endif
\ No newline at end of file